@@ -0,0 +1,369 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* wall clock timing and threads need more than POSIX.2 */
+#undef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "tiberr.h"
+#include "tibeval.h"
+#include "tibpool.h"
+
+struct file_list
+{
+	char **paths;
+	size_t len;
+	size_t bufsize;
+};
+
+struct pool
+{
+	const struct batch *batch;
+	const struct file_list *files;
+
+	/* output path of each file, or NULL if it is skipped */
+	char **outs;
+
+	pthread_mutex_t lock;
+	size_t next;
+	size_t failed;
+};
+
+static int
+list_add(struct file_list *self, const char *dir, const char *name)
+{
+	if (self->len == self->bufsize)
+	{
+		size_t bufsize = self->bufsize ? 2 * self->bufsize : 64;
+		char **paths = realloc(self->paths, bufsize * sizeof(char *));
+		if (!paths)
+			return TIB_EALLOC;
+
+		self->paths = paths;
+		self->bufsize = bufsize;
+	}
+
+	size_t len = strlen(name) + 1;
+	if (dir)
+		len += strlen(dir) + 1;
+
+	char *path = malloc(len * sizeof(char));
+	if (!path)
+		return TIB_EALLOC;
+
+	if (dir)
+		sprintf(path, "%s/%s", dir, name);
+	else
+		strcpy(path, name);
+
+	self->paths[self->len++] = path;
+	return 0;
+}
+
+static void
+list_free(struct file_list *self)
+{
+	for (size_t i = 0; i < self->len; ++i)
+		free(self->paths[i]);
+
+	free(self->paths);
+}
+
+static void
+free_outs(char **outs, size_t len)
+{
+	if (outs)
+		for (size_t i = 0; i < len; ++i)
+			free(outs[i]);
+
+	free(outs);
+}
+
+static int
+add_dir(struct file_list *self, const char *dir)
+{
+	DIR *d = opendir(dir);
+	if (!d)
+		return TIB_EBADFILE;
+
+	int rc = 0;
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		if ('.' == entry->d_name[0])
+			continue;
+
+		rc = list_add(self, dir, entry->d_name);
+		if (rc)
+			break;
+
+		/* only regular files are transcoded */
+		struct stat st;
+		const char *path = self->paths[self->len - 1];
+		if (stat(path, &st) || !S_ISREG(st.st_mode))
+			free(self->paths[--self->len]);
+	}
+
+	closedir(d);
+	return rc;
+}
+
+static char *
+output_path(const char *outdir, const char *in, const char *ext)
+{
+	const char *base = strrchr(in, '/');
+	base = base ? base + 1 : in;
+
+	const char *dot = strrchr(base, '.');
+	size_t base_len = (dot && dot != base) ? (size_t) (dot - base)
+		: strlen(base);
+
+	char *out = malloc((strlen(outdir) + base_len + strlen(ext) + 2)
+			* sizeof(char));
+	if (out)
+		sprintf(out, "%s/%.*s%s", outdir, (int) base_len, base, ext);
+
+	return out;
+}
+
+struct out_entry
+{
+	const char *out;
+	size_t i;
+};
+
+static int
+compare_outs(const void *a, const void *b)
+{
+	const struct out_entry *x = a, *y = b;
+	int c = strcmp(x->out, y->out);
+
+	if (c)
+		return c;
+
+	return (x->i > y->i) - (x->i < y->i);
+}
+
+/* Files whose output path is already taken by an earlier file would
+ * overwrite its output, so they are reported and skipped. Returns how
+ * many were, or a negative error code. */
+static long
+drop_clashes(const struct batch *self, const struct file_list *files,
+	char **outs)
+{
+	if (files->len < 2)
+		return 0;
+
+	struct out_entry *sorted = malloc(files->len
+			* sizeof(struct out_entry));
+	if (!sorted)
+		return TIB_EALLOC;
+
+	for (size_t i = 0; i < files->len; ++i)
+	{
+		sorted[i].out = outs[i];
+		sorted[i].i = i;
+	}
+
+	qsort(sorted, files->len, sizeof(struct out_entry), compare_outs);
+
+	long dropped = 0;
+	size_t first = 0;
+	for (size_t k = 1; k < files->len; ++k)
+	{
+		if (strcmp(sorted[k].out, sorted[first].out))
+		{
+			first = k;
+			continue;
+		}
+
+		fprintf(stderr,
+			"%s: %s: Output %s is already written for %s.\n",
+			self->prog, files->paths[sorted[k].i], sorted[k].out,
+			files->paths[sorted[first].i]);
+
+		free(outs[sorted[k].i]);
+		outs[sorted[k].i] = NULL;
+		++dropped;
+	}
+
+	free(sorted);
+	return dropped;
+}
+
+static void *
+worker(void *arg)
+{
+	struct pool *pool = arg;
+	const struct batch *batch = pool->batch;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&pool->lock);
+		size_t i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (i >= pool->files->len)
+			break;
+
+		const char *in = pool->files->paths[i];
+		const char *out = pool->outs[i];
+		if (!out)
+			continue;
+
+		int rc = batch->func(in, out, batch->data);
+		if (rc)
+		{
+			remove(out);
+
+			fprintf(stderr,
+				"%s: %s: Error %d occurred while processing.\n",
+				batch->prog, in, rc);
+
+			pthread_mutex_lock(&pool->lock);
+			++pool->failed;
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+
+	/* the pools and scratch memory are per thread */
+	tib_pool_clear();
+	tib_eval_free();
+	return NULL;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+batch_default_workers(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? n : 1;
+}
+
+int
+batch_run(const struct batch *self, char * const *paths, int num_paths)
+{
+	struct file_list files = { .len = 0, .bufsize = 0, .paths = NULL };
+	int rc = 0;
+
+	for (int i = 0; i < num_paths; ++i)
+	{
+		struct stat st;
+
+		if (!stat(paths[i], &st) && S_ISDIR(st.st_mode))
+			rc = add_dir(&files, paths[i]);
+		else
+			rc = list_add(&files, NULL, paths[i]);
+
+		if (rc)
+		{
+			fprintf(stderr,
+				"%s: %s: Error %d occurred while listing files.\n",
+				self->prog, paths[i], rc);
+			list_free(&files);
+			return rc;
+		}
+	}
+
+	char **outs = calloc(files.len ? files.len : 1, sizeof(char *));
+	long dropped = outs ? 0 : TIB_EALLOC;
+
+	for (size_t i = 0; i < files.len && !dropped; ++i)
+	{
+		outs[i] = output_path(self->outdir, files.paths[i], self->ext);
+		if (!outs[i])
+			dropped = TIB_EALLOC;
+	}
+
+	if (!dropped)
+		dropped = drop_clashes(self, &files, outs);
+
+	if (dropped < 0)
+	{
+		free_outs(outs, files.len);
+		list_free(&files);
+		return (int) dropped;
+	}
+
+	size_t workers = self->workers > 0 ? (size_t) self->workers : 1;
+	if (workers > files.len)
+		workers = files.len ? files.len : 1;
+
+	pthread_t *threads = malloc(workers * sizeof(pthread_t));
+	if (!threads)
+	{
+		free_outs(outs, files.len);
+		list_free(&files);
+		return TIB_EALLOC;
+	}
+
+	struct pool pool = {
+		.batch = self,
+		.files = &files,
+		.outs = outs,
+		.next = 0,
+		.failed = dropped
+	};
+	pthread_mutex_init(&pool.lock, NULL);
+
+	double start = now();
+
+	size_t started;
+	for (started = 0; started < workers; ++started)
+		if (pthread_create(&threads[started], NULL, worker, &pool))
+			break;
+
+	/* the calling thread does the work itself if no thread started */
+	if (!started)
+		worker(&pool);
+
+	for (size_t i = 0; i < started; ++i)
+		pthread_join(threads[i], NULL);
+
+	double secs = now() - start;
+
+	fprintf(stderr,
+		"%s: Processed %lu files (%lu failed) in %.3f s with %lu workers (%.1f files/s).\n",
+		self->prog, (unsigned long) files.len,
+		(unsigned long) pool.failed, secs,
+		(unsigned long) (started ? started : 1),
+		secs > 0 ? files.len / secs : 0.0);
+
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+	free_outs(outs, files.len);
+	list_free(&files);
+	return (int) pool.failed;
+}
@@ -0,0 +1,48 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_BATCH_H
+#define DELWINK_TIB_BATCH_H
+
+/* transcodes the file at in into a new file at out */
+typedef int (*batch_func)(const char *in, const char *out, void *data);
+
+struct batch
+{
+	const char *prog;
+	const char *outdir;
+	const char *ext;
+	int workers;
+
+	batch_func func;
+	void *data;
+};
+
+/* Default worker count: one per online core */
+int
+batch_default_workers(void);
+
+/* Runs func over every file named in paths, expanding directories one
+ * level deep, on a pool of worker threads. A file whose output path is
+ * the same as an earlier file's fails without being run. Errors for
+ * single files and a summary are printed to stderr. Returns the number
+ * of files that failed, or a negative error code if the batch could not
+ * start. */
+int
+batch_run(const struct batch *self, char * const *paths, int num_paths);
+
+#endif
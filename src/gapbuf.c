@@ -0,0 +1,220 @@
+/*
+ *  LiberTI - TI-like calculator designed for LibreCalc
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gapbuf.h"
+#include "tiberr.h"
+
+#define GAPBUF_MIN_SIZE 64
+
+int
+gapbuf_init(struct gapbuf *self)
+{
+	self->data = malloc(GAPBUF_MIN_SIZE * sizeof(tib_Char));
+	if (!self->data)
+		return TIB_EALLOC;
+
+	self->bufsize = GAPBUF_MIN_SIZE;
+	self->gap_beg = 0;
+	self->gap_end = GAPBUF_MIN_SIZE;
+
+	self->flat = NULL;
+	self->flat_size = 0;
+	self->flat_valid = false;
+
+	return 0;
+}
+
+void
+gapbuf_destroy(struct gapbuf *self)
+{
+	free(self->data);
+	free(self->flat);
+
+	self->data = NULL;
+	self->flat = NULL;
+	self->bufsize = 0;
+	self->gap_beg = 0;
+	self->gap_end = 0;
+	self->flat_size = 0;
+	self->flat_valid = false;
+}
+
+static int
+index_of(const struct gapbuf *self, int i)
+{
+	return (i < self->gap_beg) ? i : i + (self->gap_end - self->gap_beg);
+}
+
+int
+gapbuf_get(const struct gapbuf *self, int i)
+{
+	return self->data[index_of(self, i)];
+}
+
+void
+gapbuf_set(struct gapbuf *self, int i, int c)
+{
+	self->data[index_of(self, i)] = c;
+	self->flat_valid = false;
+}
+
+static void
+move_gap(struct gapbuf *self, int i)
+{
+	int n;
+
+	if (i < self->gap_beg)
+	{
+		n = self->gap_beg - i;
+		memmove(self->data + self->gap_end - n, self->data + i,
+			n * sizeof(tib_Char));
+		self->gap_beg -= n;
+		self->gap_end -= n;
+	}
+	else if (i > self->gap_beg)
+	{
+		n = i - self->gap_beg;
+		memmove(self->data + self->gap_beg, self->data + self->gap_end,
+			n * sizeof(tib_Char));
+		self->gap_beg += n;
+		self->gap_end += n;
+	}
+}
+
+static int
+reserve(struct gapbuf *self, int len)
+{
+	if (len <= self->bufsize)
+		return 0;
+
+	int bufsize = self->bufsize;
+	while (bufsize < len)
+		bufsize *= 2;
+
+	tib_Char *data = realloc(self->data, bufsize * sizeof(tib_Char));
+	if (!data)
+		return TIB_EALLOC;
+
+	/* keep the text after the gap at the end of the buffer */
+	int tail = self->bufsize - self->gap_end;
+	memmove(data + bufsize - tail, data + self->gap_end,
+		tail * sizeof(tib_Char));
+
+	self->data = data;
+	self->gap_end = bufsize - tail;
+	self->bufsize = bufsize;
+	return 0;
+}
+
+int
+gapbuf_insert(struct gapbuf *self, int i, int c)
+{
+	if (i < 0 || i > gapbuf_len(self))
+		return TIB_EINDEX;
+
+	int rc = reserve(self, gapbuf_len(self) + 1);
+	if (rc)
+		return rc;
+
+	move_gap(self, i);
+	self->data[self->gap_beg++] = c;
+	self->flat_valid = false;
+
+	return 0;
+}
+
+int
+gapbuf_delete(struct gapbuf *self, int i)
+{
+	if (i < 0 || i >= gapbuf_len(self))
+		return TIB_EINDEX;
+
+	move_gap(self, i);
+	++self->gap_end;
+	self->flat_valid = false;
+
+	return 0;
+}
+
+void
+gapbuf_clear(struct gapbuf *self)
+{
+	self->gap_beg = 0;
+	self->gap_end = self->bufsize;
+	self->flat_valid = false;
+}
+
+int
+gapbuf_assign(struct gapbuf *self, const struct tib_expr *src)
+{
+	gapbuf_clear(self);
+
+	int rc = reserve(self, src->len);
+	if (rc)
+		return rc;
+
+	memcpy(self->data, src->data, src->len * sizeof(tib_Char));
+	self->gap_beg = src->len;
+
+	return 0;
+}
+
+const struct tib_expr *
+gapbuf_view(struct gapbuf *self)
+{
+	int len = gapbuf_len(self);
+
+	self->view.bufsize = 0;
+	self->view.len = len;
+
+	/* nothing after the gap: the front of the buffer is the view */
+	if (self->gap_end == self->bufsize)
+	{
+		self->view.data = self->data;
+		return &self->view;
+	}
+
+	if (self->flat_valid)
+	{
+		self->view.data = self->flat;
+		return &self->view;
+	}
+
+	if (self->flat_size < len)
+	{
+		tib_Char *flat = realloc(self->flat, len * sizeof(tib_Char));
+		if (!flat)
+		{
+			tib_errno = TIB_EALLOC;
+			return NULL;
+		}
+
+		self->flat = flat;
+		self->flat_size = len;
+	}
+
+	memcpy(self->flat, self->data, self->gap_beg * sizeof(tib_Char));
+	memcpy(self->flat + self->gap_beg, self->data + self->gap_end,
+		(self->bufsize - self->gap_end) * sizeof(tib_Char));
+
+	self->flat_valid = true;
+	self->view.data = self->flat;
+	return &self->view;
+}
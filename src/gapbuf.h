@@ -0,0 +1,72 @@
+/*
+ *  LiberTI - TI-like calculator designed for LibreCalc
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_LIBERTI_GAPBUF_H
+#define DELWINK_LIBERTI_GAPBUF_H
+
+#include <stdbool.h>
+
+#include "tibexpr.h"
+
+#define gapbuf_len(B) ((B)->bufsize - ((B)->gap_end - (B)->gap_beg))
+
+/* Token buffer with a movable hole in it. Edits next to the hole are
+ * constant time; the hole follows wherever the last edit happened. */
+struct gapbuf
+{
+	tib_Char *data;
+	int bufsize;
+	int gap_beg;
+	int gap_end;
+
+	/* contiguous copy handed out by gapbuf_view */
+	tib_Char *flat;
+	int flat_size;
+	bool flat_valid;
+	struct tib_expr view;
+};
+
+int
+gapbuf_init(struct gapbuf *self);
+
+void
+gapbuf_destroy(struct gapbuf *self);
+
+int
+gapbuf_get(const struct gapbuf *self, int i);
+
+void
+gapbuf_set(struct gapbuf *self, int i, int c);
+
+int
+gapbuf_insert(struct gapbuf *self, int i, int c);
+
+int
+gapbuf_delete(struct gapbuf *self, int i);
+
+void
+gapbuf_clear(struct gapbuf *self);
+
+int
+gapbuf_assign(struct gapbuf *self, const struct tib_expr *src);
+
+/* The returned expression does not own its data and stays valid until
+ * the buffer is next modified. */
+const struct tib_expr *
+gapbuf_view(struct gapbuf *self);
+
+#endif
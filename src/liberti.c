@@ -29,7 +29,9 @@
 #include "log.h"
 #include "skin.h"
 #include "tibchar.h"
+#include "tibeval.h"
 #include "tibfunction.h"
+#include "tibpool.h"
 #include "tibvar.h"
 
 #define VERSION_STRING "0.0.0"
@@ -171,14 +173,6 @@ main(int argc, char *argv[])
 	if (rc)
 		goto end;
 
-	rc = tib_keyword_init();
-	if (rc)
-	{
-		critical("Could not initialize TI-BASIC keyword lookup tree: Error %d",
-			rc);
-		goto end;
-	}
-
 	rc = tib_var_init();
 	if (rc)
 	{
@@ -340,7 +334,6 @@ main(int argc, char *argv[])
 	IMG_Quit();
 
 	font_free();
-	tib_keyword_free();
 	tib_registry_free();
 	tib_var_free();
 
@@ -356,6 +349,15 @@ main(int argc, char *argv[])
 		state_destroy(&state);
 	}
 
+	struct tib_pool_stats pool_stats;
+	tib_pool_get_stats(&pool_stats);
+	debug("Pool hit rates: TIB %.2f, list %.2f, matrix %.2f",
+		tib_pool_hit_rate(&pool_stats.headers),
+		tib_pool_hit_rate(&pool_stats.lists),
+		tib_pool_hit_rate(&pool_stats.matrices));
+	tib_pool_clear();
+	tib_eval_free();
+
 	if (state_path)
 		free(state_path);
 
@@ -0,0 +1,134 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generates the keyword automaton used by tib_encode_str. The output is a
+ * trie over the texts returned by tib_special_char_text, written out as
+ * read-only tables: a dense transition table for the start state and sorted
+ * edge lists for every other state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tibchar.h"
+
+#define MAX_STATES 4096
+
+struct state
+{
+	int next[256];
+	int token;
+};
+
+static struct state states[MAX_STATES];
+static int num_states = 1;
+
+static int
+add_keyword(const char *s, int token)
+{
+	int cur = 0;
+
+	for (; *s; ++s)
+	{
+		unsigned char c = *s;
+
+		if (!states[cur].next[c])
+		{
+			if (MAX_STATES == num_states)
+				return 1;
+
+			states[cur].next[c] = num_states++;
+		}
+
+		cur = states[cur].next[c];
+	}
+
+	if (states[cur].token)
+		return 1;
+
+	states[cur].token = token;
+	return 0;
+}
+
+int
+main(void)
+{
+	int c, i, num_edges = 0;
+
+	for (i = TIB_FIRST_CHAR; i <= TIB_LAST_CHAR; ++i)
+	{
+		const char *s = tib_special_char_text(i);
+		if (!s)
+			continue;
+
+		if (add_keyword(s, i))
+		{
+			fprintf(stderr, "mkkeywords: bad keyword for token %d\n",
+				i);
+			return 1;
+		}
+	}
+
+	puts("/* generated by mkkeywords; do not edit */\n");
+	puts("#ifndef DELWINK_TIB_TIBKEYWORDS_H");
+	puts("#define DELWINK_TIB_TIBKEYWORDS_H\n");
+
+	puts("struct tib_kw_state\n{");
+	puts("\tunsigned short first;");
+	puts("\tunsigned short count;");
+	puts("\tunsigned short token;");
+	puts("};\n");
+
+	puts("struct tib_kw_edge\n{");
+	puts("\tunsigned char c;");
+	puts("\tunsigned short next;");
+	puts("};\n");
+
+	puts("static const unsigned short tib_kw_start[256] = {");
+	for (c = 0; c < 256; ++c)
+		printf("\t%d,\n", states[0].next[c]);
+	puts("};\n");
+
+	puts("static const struct tib_kw_state tib_kw_states[] = {");
+	for (i = 0; i < num_states; ++i)
+	{
+		int count = 0;
+
+		if (i)
+			for (c = 0; c < 256; ++c)
+				if (states[i].next[c])
+					++count;
+
+		printf("\t{ %d, %d, %d },\n", num_edges, count,
+			states[i].token);
+		num_edges += count;
+	}
+	puts("};\n");
+
+	puts("static const struct tib_kw_edge tib_kw_edges[] = {");
+	for (i = 1; i < num_states; ++i)
+		for (c = 0; c < 256; ++c)
+			if (states[i].next[c])
+				printf("\t{ %d, %d },\n", c,
+					states[i].next[c]);
+	puts("\t{ 0, 0 }");
+	puts("};\n");
+
+	puts("#endif");
+	return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generates the byte lookup tables used by tib_fread and tib_fwrite from the
+ * token byte specification in tibbytes.c. Every first byte maps to a token,
+ * to TIB_DECODE_SKIP, to TIB_DECODE_UNKNOWN or to the secondary table that
+ * decodes the byte after it. Every token maps to its length in bytes (0 if
+ * it cannot be written) followed by the bytes themselves.
+ */
+
+#include <stdio.h>
+
+#include "tibbytes.h"
+#include "tibchar.h"
+
+#define MAX_PREFIXES 16
+
+static int primary[256];
+static int secondary[MAX_PREFIXES][256];
+static int num_prefixes = 0;
+static int encode[TIB_LAST_CHAR + 1][3];
+
+static int
+prefix_index(int first)
+{
+	if (primary[first] <= TIB_DECODE_PREFIX(0))
+		return TIB_DECODE_PREFIX_INDEX(primary[first]);
+
+	if (primary[first] != TIB_DECODE_UNKNOWN
+			|| MAX_PREFIXES == num_prefixes)
+		return -1;
+
+	for (int c = 0; c < 256; ++c)
+		secondary[num_prefixes][c] = TIB_DECODE_UNKNOWN;
+
+	primary[first] = TIB_DECODE_PREFIX(num_prefixes);
+	return num_prefixes++;
+}
+
+static void
+add_encoding(const struct tib_byte_token *t)
+{
+	/* the first entry for a token is the one that gets written */
+	if (t->token <= TIB_DECODE_SKIP || t->token > TIB_LAST_CHAR
+			|| encode[t->token][0])
+		return;
+
+	encode[t->token][0] = (TIB_BYTE_NONE == t->second) ? 1 : 2;
+	encode[t->token][1] = t->first;
+	encode[t->token][2] = (TIB_BYTE_NONE == t->second) ? 0 : t->second;
+}
+
+static int
+add_token(const struct tib_byte_token *t)
+{
+	add_encoding(t);
+
+	if (TIB_BYTE_NONE == t->second)
+	{
+		if (primary[t->first] != TIB_DECODE_UNKNOWN)
+			return 1;
+
+		primary[t->first] = t->token;
+		return 0;
+	}
+
+	int i = prefix_index(t->first);
+	if (i < 0 || secondary[i][t->second] != TIB_DECODE_UNKNOWN)
+		return 1;
+
+	secondary[i][t->second] = t->token;
+	return 0;
+}
+
+static void
+print_table(const int *table)
+{
+	for (int c = 0; c < 256; c += 8)
+	{
+		putchar('\t');
+		for (int i = c; i < c + 8; ++i)
+			printf("%d,%c", table[i], i == c + 7 ? '\n' : ' ');
+	}
+}
+
+int
+main(void)
+{
+	int c, i;
+
+	for (c = 0; c < 256; ++c)
+		primary[c] = TIB_DECODE_UNKNOWN;
+
+	for (c = '0'; c <= '9'; ++c)
+	{
+		primary[c] = c;
+		encode[c][0] = 1;
+		encode[c][1] = c;
+	}
+
+	for (c = 'A'; c <= 'Z'; ++c)
+	{
+		primary[c] = c;
+		encode[c][0] = 1;
+		encode[c][1] = c;
+	}
+
+	for (i = 0; i < tib_num_byte_tokens; ++i)
+	{
+		if (add_token(&tib_byte_tokens[i]))
+		{
+			fprintf(stderr, "mktranscode: bad byte entry for token %d\n",
+				tib_byte_tokens[i].token);
+			return 1;
+		}
+	}
+
+	puts("/* generated by mktranscode; do not edit */\n");
+	puts("#ifndef DELWINK_TIB_TIBBYTETABLES_H");
+	puts("#define DELWINK_TIB_TIBBYTETABLES_H\n");
+
+	puts("static const short tib_decode_primary[256] = {");
+	print_table(primary);
+	puts("};\n");
+
+	printf("static const short tib_decode_secondary[%d][256] = {\n",
+		num_prefixes);
+	for (i = 0; i < num_prefixes; ++i)
+	{
+		puts("\t{");
+		print_table(secondary[i]);
+		puts("\t},");
+	}
+	puts("};\n");
+
+	printf("static const unsigned char tib_encode_bytes[%d][3] = {\n",
+		TIB_LAST_CHAR + 1);
+	for (i = 0; i <= TIB_LAST_CHAR; ++i)
+		printf("\t{ %d, %d, %d },\n", encode[i][0], encode[i][1],
+			encode[i][2]);
+	puts("};\n");
+
+	puts("#endif");
+	return 0;
+}
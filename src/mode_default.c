@@ -155,7 +155,7 @@ draw_cursor(const struct state *state, SDL_Surface *frame)
 	for (int i = 0; i < state->entry_cursor; ++i)
 	{
 		const char *special =
-			display_special_char(state->entry.data[i]);
+			display_special_char(gapbuf_get(&state->entry, i));
 
 		if (special)
 			x += strlen(special);
@@ -195,7 +195,12 @@ default_draw(const struct screen *screen)
 
 	struct state *state = screen->state;
 	unsigned int height = 0;
-	draw_line(&state->entry, final, &height, false);
+	const struct tib_expr *entry = gapbuf_view(&state->entry);
+	if (entry)
+		draw_line(entry, final, &height, false);
+	else
+		error("Failed to prepare entry line for drawing");
+
 	draw_cursor(state, final);
 
 	for (int i = state->history_len - 1; i >= 0 && height < 64; --i)
@@ -241,12 +246,12 @@ default_input(struct screen *screen, SDL_KeyboardEvent *key)
 		--state->entry_cursor;
 		// SPILLS OVER!
 	case SDLK_DELETE:
-		if (state->entry_cursor < state->entry.len)
-			tib_expr_delete(&state->entry, state->entry_cursor);
+		if (state->entry_cursor < gapbuf_len(&state->entry))
+			gapbuf_delete(&state->entry, state->entry_cursor);
 		return 0;
 
 	case SDLK_END:
-		state->entry_cursor = state->entry.len;
+		state->entry_cursor = gapbuf_len(&state->entry);
 		return 0;
 
 	case SDLK_HOME:
@@ -269,7 +274,7 @@ default_input(struct screen *screen, SDL_KeyboardEvent *key)
 		}
 		else
 		{
-			if (0 == state->entry.len)
+			if (0 == gapbuf_len(&state->entry))
 			{
 				int rc = entry_write(state, TIB_CHAR_ANS);
 				if (rc)
@@ -287,7 +292,7 @@ default_input(struct screen *screen, SDL_KeyboardEvent *key)
 	int normal = normalize_keycode(code, mod);
 	if (normal)
 	{
-		if (is_math_operator(normal) && 0 == state->entry.len
+		if (is_math_operator(normal) && 0 == gapbuf_len(&state->entry)
 			&& !(mod & KMOD_CTRL))
 		{
 			int rc = entry_write(state, TIB_CHAR_ANS);
@@ -49,6 +49,29 @@ add_history(struct state *state, struct tib_expr *in, struct tib_expr *ans_s,
 	state->history[i].answer = ans;
 }
 
+/* on success the entry is cleared, so expr may be a view of it */
+static int
+calc(struct state *state, const struct tib_expr *expr)
+{
+	TIB *ans = tib_eval(expr);
+	if (!ans)
+		return tib_errno;
+
+	int rc = state_add_history(state, expr, ans);
+	if (rc)
+	{
+		tib_decref(ans);
+		return rc;
+	}
+
+	state->entry_cursor = 0;
+	gapbuf_clear(&state->entry);
+
+	rc = tib_var_set(TIB_CHAR_ANS, ans);
+	tib_decref(ans);
+	return rc;
+}
+
 int
 load_state(struct state *dest, const char *path)
 {
@@ -63,7 +86,7 @@ load_state(struct state *dest, const char *path)
 	dest->blink_state = true;
 	dest->insert_mode = false;
 
-	rc = tib_expr_init(&dest->entry);
+	rc = gapbuf_init(&dest->entry);
 	if (rc)
 		return rc;
 
@@ -109,11 +132,12 @@ load_state(struct state *dest, const char *path)
 			}
 
 			const char *s = config_setting_get_string(e);
-			rc = tib_encode_str(&dest->entry, s);
-			if (rc)
-				goto fail;
+			struct tib_expr expr = { .bufsize = 0 };
+			rc = tib_encode_str(&expr, s);
+			if (!rc)
+				rc = calc(dest, &expr);
 
-			rc = state_calc_entry(dest);
+			tib_expr_destroy(&expr);
 			if (rc)
 				goto fail;
 		}
@@ -132,6 +156,8 @@ int
 save_state(const struct state *state, const char *path)
 {
 	int rc = 0;
+	char *s = NULL;
+	size_t s_size = 0;
 
 	if (!state || !path)
 		return TIB_ENULLPTR;
@@ -157,15 +183,13 @@ save_state(const struct state *state, const char *path)
 							CONFIG_TYPE_STRING);
 		CHECK_NULL(info);
 
-		char *s = tib_expr_tostr(&state->history[i].entry);
-		if (!s)
-		{
-			rc = tib_errno;
+		rc = tib_expr_tostr_buf(&state->history[i].entry,
+					tib_special_char_text, &s, &s_size,
+					NULL);
+		if (rc)
 			goto end;
-		}
 
 		rc = config_setting_set_string(info, s);
-		free(s);
 		if (CONFIG_FALSE == rc)
 		{
 			rc = TIB_EALLOC;
@@ -179,6 +203,7 @@ save_state(const struct state *state, const char *path)
 	config_write_file(&conf, path);
 
  end:
+	free(s);
 	config_destroy(&conf);
 	return rc;
 }
@@ -186,7 +211,7 @@ save_state(const struct state *state, const char *path)
 void
 state_destroy(struct state *state)
 {
-	tib_expr_destroy(&state->entry);
+	gapbuf_destroy(&state->entry);
 	state_clear_history(state);
 }
 
@@ -195,8 +220,8 @@ entry_move_cursor(struct state *state, int distance)
 {
 	state->entry_cursor += distance;
 
-	if (state->entry_cursor > state->entry.len)
-		state->entry_cursor = state->entry.len;
+	if (state->entry_cursor > gapbuf_len(&state->entry))
+		state->entry_cursor = gapbuf_len(&state->entry);
 	else if (state->entry_cursor < 0)
 		state->entry_cursor = 0;
 
@@ -206,7 +231,7 @@ entry_move_cursor(struct state *state, int distance)
 static int
 entry_insert(struct state *state, int c)
 {
-	int rc = tib_expr_insert(&state->entry, state->entry_cursor, c);
+	int rc = gapbuf_insert(&state->entry, state->entry_cursor, c);
 	if (!rc)
 	{
 		++state->entry_cursor;
@@ -220,10 +245,11 @@ entry_insert(struct state *state, int c)
 int
 entry_write(struct state *state, int c)
 {
-	if (state->insert_mode || state->entry_cursor == state->entry.len)
+	if (state->insert_mode
+		|| state->entry_cursor == gapbuf_len(&state->entry))
 		return entry_insert(state, c);
 
-	state->entry.data[state->entry_cursor++] = c;
+	gapbuf_set(&state->entry, state->entry_cursor++, c);
 	state->action_state = STATE_NORMAL;
 	return 0;
 }
@@ -233,16 +259,16 @@ entry_recall(struct state *state)
 {
 	if (state->history_len)
 	{
-		int rc = tib_exprcpy(&state->entry,
+		int rc = gapbuf_assign(&state->entry,
 				&state->history[state->history_len - 1].entry);
 		if (rc)
 			return rc;
 
-		state->entry_cursor = state->entry.len;
+		state->entry_cursor = gapbuf_len(&state->entry);
 	}
 	else
 	{
-		state->entry.len = 0;
+		gapbuf_clear(&state->entry);
 	}
 
 	return 0;
@@ -260,23 +286,11 @@ change_action_state(struct state *state, enum action_state action_state)
 int
 state_calc_entry(struct state *state)
 {
-	TIB *ans = tib_eval(&state->entry);
-	if (!ans)
+	const struct tib_expr *entry = gapbuf_view(&state->entry);
+	if (!entry)
 		return tib_errno;
 
-	int rc = state_add_history(state, &state->entry, ans);
-	if (rc)
-	{
-		tib_decref(ans);
-		return rc;
-	}
-
-	state->entry_cursor = 0;
-	state->entry.len = 0;
-
-	rc = tib_var_set(TIB_CHAR_ANS, ans);
-	tib_decref(ans);
-	return rc;
+	return calc(state, entry);
 }
 
 int
@@ -18,6 +18,7 @@
 #ifndef DELWINK_LIBERTI_STATE_H
 #define DELWINK_LIBERTI_STATE_H
 
+#include "gapbuf.h"
 #include "tibexpr.h"
 #include "tibtype.h"
 
@@ -42,7 +43,7 @@ struct history
 struct state
 {
 	struct history history[MAX_HISTORY];
-	struct tib_expr entry;
+	struct gapbuf entry;
 
 	enum action_state action_state;
 	int entry_cursor;
@@ -0,0 +1,176 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiberr.h"
+#include "tibarena.h"
+
+union align
+{
+	long double d;
+	long long l;
+	void *p;
+	void (*f)(void);
+};
+
+#define ALIGN sizeof(union align)
+#define ROUND_UP(N) (((N) + ALIGN - 1) / ALIGN * ALIGN)
+
+struct tib_arena_block
+{
+	struct tib_arena_block *prev;
+	size_t size;
+	size_t used;
+
+	union align data[];
+};
+
+void
+tib_arena_init(struct tib_arena *self)
+{
+	self->head = NULL;
+	self->spare = NULL;
+}
+
+void
+tib_arena_destroy(struct tib_arena *self)
+{
+	while (self->head)
+	{
+		struct tib_arena_block *prev = self->head->prev;
+		free(self->head);
+		self->head = prev;
+	}
+
+	free(self->spare);
+	self->spare = NULL;
+}
+
+static struct tib_arena_block *
+new_block(struct tib_arena *self, size_t size)
+{
+	struct tib_arena_block *block = self->spare;
+
+	if (block && block->size >= size)
+	{
+		self->spare = NULL;
+	}
+	else
+	{
+		if (size < TIB_ARENA_BLOCK_SIZE)
+			size = TIB_ARENA_BLOCK_SIZE;
+
+		block = malloc(sizeof(struct tib_arena_block) + size);
+		if (!block)
+			return NULL;
+
+		block->size = size;
+	}
+
+	block->prev = self->head;
+	block->used = 0;
+	self->head = block;
+
+	return block;
+}
+
+void *
+tib_arena_alloc(struct tib_arena *self, size_t size)
+{
+	struct tib_arena_block *block = self->head;
+
+	size = ROUND_UP(size);
+	if (!block || block->size - block->used < size)
+	{
+		block = new_block(self, size);
+		if (!block)
+		{
+			tib_errno = TIB_EALLOC;
+			return NULL;
+		}
+	}
+
+	void *out = (char *) block->data + block->used;
+	block->used += size;
+
+	return out;
+}
+
+/* grows in place when p is the most recent allocation */
+void *
+tib_arena_realloc(struct tib_arena *self, void *p, size_t old_size,
+		size_t size)
+{
+	struct tib_arena_block *block = self->head;
+
+	if (p && block)
+	{
+		size_t old_used = ROUND_UP(old_size);
+		char *end = (char *) block->data + block->used;
+
+		if ((char *) p + old_used == end
+			&& block->size - block->used + old_used
+			>= ROUND_UP(size))
+		{
+			block->used += ROUND_UP(size) - old_used;
+			return p;
+		}
+	}
+
+	void *out = tib_arena_alloc(self, size);
+	if (out && p)
+		memcpy(out, p, old_size < size ? old_size : size);
+
+	return out;
+}
+
+struct tib_arena_mark
+tib_arena_mark(const struct tib_arena *self)
+{
+	struct tib_arena_mark mark = {
+		.block = self->head,
+		.used = self->head ? self->head->used : 0
+	};
+
+	return mark;
+}
+
+/* the largest discarded block is kept for the next evaluation */
+void
+tib_arena_release(struct tib_arena *self, struct tib_arena_mark mark)
+{
+	while (self->head != mark.block)
+	{
+		struct tib_arena_block *block = self->head;
+		self->head = block->prev;
+
+		if (!self->spare || self->spare->size < block->size)
+		{
+			free(self->spare);
+			self->spare = block;
+		}
+		else
+		{
+			free(block);
+		}
+	}
+
+	if (self->head)
+		self->head->used = mark.used;
+}
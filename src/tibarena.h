@@ -0,0 +1,61 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_ARENA_H
+#define DELWINK_TIB_ARENA_H
+
+#include <stddef.h>
+
+#define TIB_ARENA_BLOCK_SIZE 4096
+
+struct tib_arena_block;
+
+/* Bump allocator for memory that lives exactly as long as one
+ * evaluation. Nothing is freed individually; the owner takes a mark
+ * before starting and releases back to it when done. */
+struct tib_arena
+{
+	struct tib_arena_block *head;
+	struct tib_arena_block *spare;
+};
+
+struct tib_arena_mark
+{
+	struct tib_arena_block *block;
+	size_t used;
+};
+
+void
+tib_arena_init(struct tib_arena *self);
+
+void
+tib_arena_destroy(struct tib_arena *self);
+
+void *
+tib_arena_alloc(struct tib_arena *self, size_t size);
+
+void *
+tib_arena_realloc(struct tib_arena *self, void *p, size_t old_size,
+		size_t size);
+
+struct tib_arena_mark
+tib_arena_mark(const struct tib_arena *self);
+
+void
+tib_arena_release(struct tib_arena *self, struct tib_arena_mark mark);
+
+#endif
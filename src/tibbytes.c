@@ -0,0 +1,139 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tibbytes.h"
+#include "tibchar.h"
+
+/* The original author of LibreCalc's TI emulator had several comments in
+ * this conversion table where he was unsure of the legitimacy of some
+ * character conversion. Be wary of the following: 0x5B, 0x6D or 0x0E,
+ * 0x72, 0x62, 0x18, 0x7F or 0xD8, 0x5F
+ *
+ * Digits and capital letters are stored as themselves and are not listed.
+ */
+const struct tib_byte_token tib_byte_tokens[] = {
+	{ TIB_CHAR_STO, 0x04, TIB_BYTE_NONE },
+	{ '[', 0x06, TIB_BYTE_NONE },
+	{ ']', 0x07, TIB_BYTE_NONE },
+	{ '{', 0x08, TIB_BYTE_NONE },
+	{ '}', 0x09, TIB_BYTE_NONE },
+	{ TIB_CHAR_DEGREE, 0x0B, TIB_BYTE_NONE },
+	{ 'T', 0x0E, TIB_BYTE_NONE },
+	{ '(', 0x10, TIB_BYTE_NONE },
+	{ ')', 0x11, TIB_BYTE_NONE },
+	{ TIB_CHAR_ROUND, 0x12, TIB_BYTE_NONE },
+	{ TIB_CHAR_PIXEL_TEST, 0x13, TIB_BYTE_NONE },
+	{ '|', 0x16, TIB_BYTE_NONE },
+
+	/* 0x18 was simply skipped in the original emulator */
+	{ TIB_DECODE_SKIP, 0x18, TIB_BYTE_NONE },
+
+	{ ' ', 0x29, TIB_BYTE_NONE },
+	{ '"', 0x2A, TIB_BYTE_NONE },
+	{ ',', 0x2B, TIB_BYTE_NONE },
+	{ '!', 0x2D, TIB_BYTE_NONE },
+	{ '.', 0x3A, TIB_BYTE_NONE },
+	{ TIB_CHAR_EPOW10, 0x3B, TIB_BYTE_NONE },
+	{ TIB_CHAR_OR, 0x3C, TIB_BYTE_NONE },
+	{ '\n', 0x3E, TIB_BYTE_NONE },
+	{ '\n', 0x3F, TIB_BYTE_NONE },
+	{ TIB_CHAR_AND, 0x40, TIB_BYTE_NONE },
+	{ TIB_CHAR_THETA, 0x5B, TIB_BYTE_NONE },
+
+	{ TIB_CHAR_MATA, 0x5C, 0x00 },
+	{ TIB_CHAR_MATB, 0x5C, 0x01 },
+	{ TIB_CHAR_MATC, 0x5C, 0x02 },
+	{ TIB_CHAR_MATD, 0x5C, 0x03 },
+	{ TIB_CHAR_MATE, 0x5C, 0x04 },
+	{ TIB_CHAR_MATF, 0x5C, 0x05 },
+	{ TIB_CHAR_MATG, 0x5C, 0x06 },
+	{ TIB_CHAR_MATH, 0x5C, 0x07 },
+	{ TIB_CHAR_MATI, 0x5C, 0x08 },
+
+	{ TIB_CHAR_L1, 0x5D, 0x00 },
+	{ TIB_CHAR_L2, 0x5D, 0x01 },
+	{ TIB_CHAR_L3, 0x5D, 0x02 },
+	{ TIB_CHAR_L4, 0x5D, 0x03 },
+	{ TIB_CHAR_L5, 0x5D, 0x04 },
+	{ TIB_CHAR_L6, 0x5D, 0x05 },
+	{ TIB_CHAR_L7, 0x5D, 0x06 },
+	{ TIB_CHAR_L8, 0x5D, 0x07 },
+	{ TIB_CHAR_L9, 0x5D, 0x08 },
+
+	/* 0x5F was not evaluated, but it printed "Pause  " to stdout */
+
+	{ TIB_CHAR_PIC1, 0x60, 0x00 },
+	{ 'c', 0x62, TIB_BYTE_NONE },
+
+	{ TIB_CHAR_XMIN, 0x63, 0x0A },
+	{ TIB_CHAR_XMAX, 0x63, 0x0B },
+	{ TIB_CHAR_YMIN, 0x63, 0x0C },
+	{ TIB_CHAR_YMAX, 0x63, 0x0D },
+
+	{ '=', 0x6A, TIB_BYTE_NONE },
+	{ '<', 0x6B, TIB_BYTE_NONE },
+	{ '>', 0x6C, TIB_BYTE_NONE },
+	{ TIB_CHAR_LESSEQUAL, 0x6D, TIB_BYTE_NONE },
+	{ TIB_CHAR_GREATEREQUAL, 0x6E, TIB_BYTE_NONE },
+	{ TIB_CHAR_DIFFERENT, 0x6F, TIB_BYTE_NONE },
+	{ '+', 0x70, TIB_BYTE_NONE },
+	{ '-', 0x71, TIB_BYTE_NONE },
+	{ TIB_CHAR_ANS, 0x72, TIB_BYTE_NONE },
+	{ TIB_CHAR_AXESOFF, 0x7E, 0x09 },
+	{ '[', 0x7F, TIB_BYTE_NONE },
+
+	{ '*', 0x82, TIB_BYTE_NONE },
+	{ '/', 0x83, TIB_BYTE_NONE },
+	{ TIB_CHAR_CLEARDRAW, 0x85, TIB_BYTE_NONE },
+	{ TIB_CHAR_TEXT, 0x93, TIB_BYTE_NONE },
+	{ TIB_CHAR_STOREPIC, 0x98, TIB_BYTE_NONE },
+	{ TIB_CHAR_RECALLPIC, 0x99, TIB_BYTE_NONE },
+	{ TIB_CHAR_LINE, 0x9C, TIB_BYTE_NONE },
+	{ TIB_CHAR_RAND, 0xAB, TIB_BYTE_NONE },
+	{ TIB_CHAR_PI, 0xAC, TIB_BYTE_NONE },
+	{ TIB_CHAR_GETKEY, 0xAD, TIB_BYTE_NONE },
+	{ '?', 0xAF, TIB_BYTE_NONE },
+	{ TIB_CHAR_SMALL_MINUS, 0xB0, TIB_BYTE_NONE },
+	{ TIB_CHAR_INT, 0xB1, TIB_BYTE_NONE },
+	{ TIB_CHAR_DIM, 0xB5, TIB_BYTE_NONE },
+	{ TIB_CHAR_NOT, 0xB8, TIB_BYTE_NONE },
+	{ TIB_CHAR_RANDINT, 0xBB, 0x0A },
+	{ TIB_CHAR_IF, 0xCE, TIB_BYTE_NONE },
+	{ TIB_CHAR_THEN, 0xCF, TIB_BYTE_NONE },
+	{ TIB_CHAR_ELSE, 0xD0, TIB_BYTE_NONE },
+	{ TIB_CHAR_WHILE, 0xD1, TIB_BYTE_NONE },
+	{ TIB_CHAR_REPEAT, 0xD2, TIB_BYTE_NONE },
+	{ TIB_CHAR_FOR, 0xD3, TIB_BYTE_NONE },
+	{ TIB_CHAR_END, 0xD4, TIB_BYTE_NONE },
+	{ TIB_CHAR_RETURN, 0xD5, TIB_BYTE_NONE },
+	{ TIB_CHAR_LABEL, 0xD6, TIB_BYTE_NONE },
+	{ TIB_CHAR_GOTO, 0xD7, TIB_BYTE_NONE },
+	{ TIB_CHAR_PAUSE, 0xD8, TIB_BYTE_NONE },
+	{ TIB_CHAR_STOP, 0xD9, TIB_BYTE_NONE },
+	{ TIB_CHAR_INPUT, 0xDC, TIB_BYTE_NONE },
+	{ TIB_CHAR_DISP, 0xDE, TIB_BYTE_NONE },
+	{ TIB_CHAR_OUTPUT, 0xE0, TIB_BYTE_NONE },
+	{ TIB_CHAR_CLEARHOME, 0xE1, TIB_BYTE_NONE },
+	{ TIB_CHAR_FILL, 0xE2, TIB_BYTE_NONE },
+	{ TIB_CHAR_MENU, 0xE6, TIB_BYTE_NONE },
+	{ TIB_CHAR_LUSER, 0xEB, TIB_BYTE_NONE },
+	{ '^', 0xF0, TIB_BYTE_NONE },
+	{ TIB_CHAR_CLRLIST, 0xFA, TIB_BYTE_NONE }
+};
+
+const int tib_num_byte_tokens =
+	sizeof tib_byte_tokens / sizeof tib_byte_tokens[0];
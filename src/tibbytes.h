@@ -0,0 +1,41 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_TIBBYTES_H
+#define DELWINK_TIB_TIBBYTES_H
+
+/* marks a one-byte token */
+#define TIB_BYTE_NONE (-1)
+
+/* decode table values besides tokens */
+#define TIB_DECODE_SKIP 0
+#define TIB_DECODE_UNKNOWN (-1)
+#define TIB_DECODE_PREFIX(N) (-2 - (N))
+#define TIB_DECODE_PREFIX_INDEX(V) (-2 - (V))
+
+/* how a token is stored in a program file */
+struct tib_byte_token
+{
+	int token;
+	int first;
+	int second;
+};
+
+extern const struct tib_byte_token tib_byte_tokens[];
+extern const int tib_num_byte_tokens;
+
+#endif
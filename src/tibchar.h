@@ -20,6 +20,11 @@
 
 #include "tibexpr.h"
 
+/* <ctype.h> is only defined for unsigned char values; these accept any
+ * token */
+#define tib_isdigit(C) ((C) >= '0' && (C) <= '9')
+#define tib_isupper(C) ((C) >= 'A' && (C) <= 'Z')
+
 enum tib_special_char
 {
 	/* printing characters */
@@ -123,10 +128,4 @@ tib_special_char_text(int c);
 int
 tib_encode_str(struct tib_expr *dest, const char *src);
 
-int
-tib_keyword_init(void);
-
-void
-tib_keyword_free(void);
-
 #endif
@@ -19,16 +19,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "batch.h"
 #include "tiberr.h"
+#include "tibfile.h"
 #include "tibtranscode.h"
 
-#define USAGE_INFO "USAGE: tibdecode [options]\n\n\
-tibdecode reads a TI-82 or TI-83 program from stdin and prints to stdout.\n\n\
+#define USAGE_INFO "USAGE: tibdecode [options] [FILE...]\n\n\
+tibdecode reads a TI-82 or TI-83 program from stdin and prints to stdout.\n\
+If FILEs are given, the programs stored in each are printed instead.\n\
+With -o, FILEs and directories are decoded in parallel into DIR.\n\n\
 OPTIONS:\n\
+\t-a\tAlso prints the numbers, lists and matrices stored in FILEs\n\
 \t-d\tShows the decimal value of unknown characters in {}\n\
 \t-h\tPrints this help message and exits\n\
+\t-j N\tUses N worker threads (default: one per core)\n\
+\t-o DIR\tWrites decoded files into DIR\n\
+\t-s\tPrints decoding throughput to stderr\n\
 \t-v\tPrints version info and exits\n"
 
 #define VERSION_INFO "tibdecode (Delwink LiberTI) 0.0.0\n\
@@ -48,26 +57,141 @@ isascii(int c)
 }
 #endif
 
+static int
+print_expr(const struct tib_expr *expr, bool debug, FILE *out)
+{
+	char *s = tib_expr_tostr(expr);
+	if (NULL == s)
+		return tib_errno;
+
+	size_t len = strlen(s);
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (debug && !isascii(s[i]))
+			fprintf(out, "`%d`", s[i]);
+		else
+			putc(s[i], out);
+	}
+
+	free(s);
+	return 0;
+}
+
+struct options
+{
+	bool debug;
+	bool values;
+};
+
+static int
+print_value(const struct tib_file_var *var, bool debug, FILE *out)
+{
+	TIB *t = tib_file_var_value(var);
+	if (NULL == t)
+		return tib_errno;
+
+	struct tib_expr expr;
+	int rc = tib_toexpr(&expr, t);
+	tib_decref(t);
+
+	if (!rc)
+		rc = print_expr(&expr, debug, out);
+	if (!rc)
+		putc('\n', out);
+
+	tib_expr_destroy(&expr);
+	return rc;
+}
+
+static int
+decode_file(const char *path, const struct options *opts, FILE *out)
+{
+	struct tib_file file;
+
+	int rc = tib_file_open(&file, path);
+	if (rc)
+		return rc;
+
+	for (int i = 0; i < file.num_vars; ++i)
+	{
+		struct tib_expr expr = { .bufsize = 0 };
+
+		rc = tib_file_var_tokens(&file.vars[i], &expr);
+		if (!rc)
+			rc = print_expr(&expr, opts->debug, out);
+		else if (TIB_ETYPE == rc && opts->values)
+			rc = print_value(&file.vars[i], opts->debug, out);
+		else if (TIB_ETYPE == rc)
+			rc = 0;
+
+		tib_expr_destroy(&expr);
+		if (rc)
+			break;
+	}
+
+	tib_file_close(&file);
+	return rc;
+}
+
+static int
+decode_batch(const char *in, const char *out_path, void *data)
+{
+	FILE *out = fopen(out_path, "w");
+	if (!out)
+		return TIB_EWRITE;
+
+	int rc = decode_file(in, data, out);
+	if (fclose(out) && !rc)
+		rc = TIB_EWRITE;
+
+	return rc;
+}
+
 int
 main(int argc, char *argv[])
 {
-	bool debug = false;
+	struct batch batch = {
+		.prog = "tibdecode",
+		.outdir = NULL,
+		.ext = ".txt",
+		.workers = batch_default_workers(),
+		.func = decode_batch,
+		.data = NULL
+	};
+	struct options opts = { .debug = false, .values = false };
+	bool stats = false;
 
 	if (argc > 1)
 	{
 		int c;
-		while ((c = getopt(argc, argv, "dhv")) != -1)
+		while ((c = getopt(argc, argv, "adhj:o:sv")) != -1)
 		{
 			switch (c)
 			{
+			case 'a':
+				opts.values = true;
+				break;
+
 			case 'd':
-				debug = true;
+				opts.debug = true;
 				break;
 
 			case 'h':
 				puts(USAGE_INFO);
 				return 0;
 
+			case 'j':
+				batch.workers = atoi(optarg);
+				break;
+
+			case 'o':
+				batch.outdir = optarg;
+				break;
+
+			case 's':
+				stats = true;
+				break;
+
 			case 'v':
 				puts(VERSION_INFO);
 				return 0;
@@ -78,8 +202,34 @@ main(int argc, char *argv[])
 		}
 	}
 
+	if (optind < argc && batch.outdir)
+	{
+		batch.data = &opts;
+		return batch_run(&batch, argv + optind, argc - optind) ? 1 : 0;
+	}
+
+	if (optind < argc)
+	{
+		int ret = 0;
+
+		for (int i = optind; i < argc; ++i)
+		{
+			tib_errno = decode_file(argv[i], &opts, stdout);
+			if (tib_errno)
+			{
+				fprintf(stderr,
+					"tibdecode: %s: Error %d occurred while processing.\n",
+					argv[i], tib_errno);
+				ret = 1;
+			}
+		}
+
+		return ret;
+	}
+
 	struct tib_expr translated;
 	unsigned long parsed;
+	clock_t start = clock();
 	tib_errno = tib_fread(&translated, stdin, &parsed);
 	if (tib_errno)
 	{
@@ -89,9 +239,19 @@ main(int argc, char *argv[])
 		return 1;
 	}
 
-	char *s = tib_expr_tostr(&translated);
+	if (stats)
+	{
+		double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+		fprintf(stderr,
+			"tibdecode: Decoded %lu bytes into %d tokens in %.3f s (%.2f MB/s).\n",
+			parsed, translated.len, secs,
+			secs > 0 ? parsed / secs / 1e6 : 0.0);
+	}
+
+	tib_errno = print_expr(&translated, opts.debug, stdout);
 	tib_expr_destroy(&translated);
-	if (NULL == s)
+	if (tib_errno)
 	{
 		fprintf(stderr,
 			"tibdecode: Error %d occurred while processing\n",
@@ -99,15 +259,5 @@ main(int argc, char *argv[])
 		return 1;
 	}
 
-	size_t len = strlen(s);
-	for (size_t i = 0; i < len; ++i)
-	{
-		if (debug && !isascii(s[i]))
-			printf("`%d`", s[i]);
-		else
-			putchar(s[i]);
-	}
-
-	free(s);
 	return 0;
 }
@@ -15,19 +15,34 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/* ftruncate needs more than POSIX.2 */
+#undef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "batch.h"
 #include "tibchar.h"
 #include "tibtranscode.h"
 #include "tiberr.h"
 
-#define USAGE_INFO "USAGE: tibencode [options]\n\n\
-tibencode reads a TI-BASIC program from stdin and prints to stdout.\n\n\
+#define USAGE_INFO "USAGE: tibencode [options] [FILE...]\n\n\
+tibencode reads a TI-BASIC program from stdin and prints to stdout.\n\
+If FILEs or directories are given, each file is encoded into the output\n\
+directory in parallel instead.\n\n\
 OPTIONS:\n\
 \t-h\tPrints this help message and exits\n\
+\t-j N\tUses N worker threads (default: one per core)\n\
+\t-n NAME\tSets the program name (default: A, or the file name)\n\
+\t-o DIR\tWrites encoded files into DIR\n\
+\t-s\tPrints throughput statistics to stderr\n\
 \t-v\tPrints version info and exits\n"
 
 #define VERSION_INFO "tibencode (Delwink LiberTI) 0.0.0\n\
@@ -37,15 +52,214 @@ This is libre software: you are free to change and redistribute it.\n\
 There is NO WARRANTY, to the extent permitted by law.\n\n\
 Written by David McMackins II."
 
+#define READ_BLOCK_SIZE 65536
+
+static int
+encode_line(struct tib_fwriter *writer, struct tib_expr *line,
+		const char *s, bool newline)
+{
+	int rc = tib_encode_str(line, s);
+	if (rc)
+		return rc;
+
+	if (newline)
+	{
+		rc = tib_expr_push(line, '\n');
+		if (rc)
+			return rc;
+	}
+
+	return tib_fwriter_write(writer, line);
+}
+
+static int
+copy_file(FILE *from, FILE *to, char *block)
+{
+	size_t n;
+
+	rewind(from);
+	while ((n = fread(block, sizeof(char), READ_BLOCK_SIZE, from)) > 0)
+	{
+		if (fwrite(block, sizeof(char), n, to) != n)
+			return TIB_EWRITE;
+	}
+
+	if (ferror(from) || fflush(to))
+		return TIB_EWRITE;
+
+	return 0;
+}
+
+static int
+grow_line(char **buf, size_t *max_line_len, size_t needed)
+{
+	size_t size = *max_line_len;
+
+	while (size < needed)
+		size *= 2;
+
+	if (size == *max_line_len)
+		return 0;
+
+	char *grown = realloc(*buf, size * sizeof(char));
+	if (!grown)
+		return TIB_EALLOC;
+
+	*buf = grown;
+	*max_line_len = size;
+	return 0;
+}
+
+/* encodes all of in through a writer that has been initialized */
+static int
+encode_stream(FILE *in, struct tib_fwriter *writer, char *block,
+		unsigned long *nread)
+{
+	struct tib_expr line = { .bufsize = 0 };
+	size_t max_line_len = 128, line_len = 0, n;
+	int rc = 0;
+
+	char *buf = malloc(max_line_len * sizeof(char));
+	if (NULL == buf)
+		return TIB_EALLOC;
+
+	*nread = 0;
+	while ((n = fread(block, sizeof(char), READ_BLOCK_SIZE, in)) > 0)
+	{
+		const char *p = block, *block_end = block + n;
+
+		*nread += n;
+		while (p < block_end)
+		{
+			const char *nl = memchr(p, '\n', block_end - p);
+			size_t len = (nl ? nl : block_end) - p;
+
+			rc = grow_line(&buf, &max_line_len, line_len + len + 1);
+			if (rc)
+				goto end;
+
+			memcpy(buf + line_len, p, len);
+			line_len += len;
+
+			if (!nl)
+				break;
+
+			buf[line_len] = '\0';
+			rc = encode_line(writer, &line, buf, true);
+			if (rc)
+				goto end;
+
+			line_len = 0;
+			p = nl + 1;
+		}
+	}
+
+	if (ferror(in))
+	{
+		rc = TIB_EBADFILE;
+		goto end;
+	}
+
+	buf[line_len] = '\0';
+	rc = encode_line(writer, &line, buf, false);
+	if (!rc)
+		rc = tib_fwriter_finish(writer);
+
+ end:
+	free(buf);
+	tib_expr_destroy(&line);
+	return rc;
+}
+
+/* cuts the output back to where the writer started */
+static void
+discard_output(const struct tib_fwriter *writer)
+{
+	fflush(writer->out);
+	if (writer->start < 0
+			|| ftruncate(fileno(writer->out), writer->start))
+		fputs("tibencode: Error removing partial output.\n", stderr);
+}
+
+/* Derives a program name from the file name: its capital letters and
+ * digits up to the extension. Returns NULL if nothing usable is left. */
+static const char *
+program_name(const char *path, char *name)
+{
+	const char *base = strrchr(path, '/');
+	int len = 0;
+
+	for (base = base ? base + 1 : path; *base && *base != '.'; ++base)
+	{
+		int c = toupper((unsigned char) *base);
+
+		if (len < TIB_FILE_NAME_LEN
+				&& (tib_isupper(c) || (len && tib_isdigit(c))))
+			name[len++] = c;
+	}
+
+	name[len] = '\0';
+	return len ? name : NULL;
+}
+
+static int
+encode_file(const char *in_path, const char *out_path, void *data)
+{
+	char derived[TIB_FILE_NAME_LEN + 1];
+	const char *name = data ? data : program_name(in_path, derived);
+	struct tib_fwriter writer;
+	unsigned long nread;
+	int rc;
+
+	char *block = malloc(READ_BLOCK_SIZE * sizeof(char));
+	if (!block)
+		return TIB_EALLOC;
+
+	FILE *in = fopen(in_path, "r");
+	if (!in)
+	{
+		free(block);
+		return TIB_EBADFILE;
+	}
+
+	FILE *out = fopen(out_path, "wb");
+	if (!out)
+	{
+		fclose(in);
+		free(block);
+		return TIB_EWRITE;
+	}
+
+	rc = tib_fwriter_init(&writer, out, name, 0);
+	if (!rc)
+		rc = encode_stream(in, &writer, block, &nread);
+
+	if (fclose(out) && !rc)
+		rc = TIB_EWRITE;
+
+	fclose(in);
+	free(block);
+	return rc;
+}
+
 int
 main(int argc, char *argv[])
 {
-	unsigned long written;
+	struct batch batch = {
+		.prog = "tibencode",
+		.outdir = NULL,
+		.ext = ".8xp",
+		.workers = batch_default_workers(),
+		.func = encode_file,
+		.data = NULL
+	};
+	const char *name = NULL;
+	bool stats = false;
 
 	if (argc > 1)
 	{
 		int c;
-		while ((c = getopt(argc, argv, "hv")) != -1)
+		while ((c = getopt(argc, argv, "hj:n:o:sv")) != -1)
 		{
 			switch (c)
 			{
@@ -53,6 +267,22 @@ main(int argc, char *argv[])
 				puts(USAGE_INFO);
 				return 0;
 
+			case 'j':
+				batch.workers = atoi(optarg);
+				break;
+
+			case 'n':
+				name = optarg;
+				break;
+
+			case 'o':
+				batch.outdir = optarg;
+				break;
+
+			case 's':
+				stats = true;
+				break;
+
 			case 'v':
 				puts(VERSION_INFO);
 				return 0;
@@ -63,104 +293,80 @@ main(int argc, char *argv[])
 		}
 	}
 
-	tib_errno = tib_keyword_init();
-	if (tib_errno)
+	if (optind < argc)
 	{
-		fputs("tibencode: Error allocating space for keyword tree.\n",
-			stderr);
-		return 1;
-	}
+		if (!batch.outdir)
+		{
+			fputs("tibencode: -o is required when FILEs are given.\n",
+				stderr);
+			return 1;
+		}
 
-	struct tib_expr translated;
-	tib_errno = tib_expr_init(&translated);
-	if (tib_errno)
-	{
-		fputs("tibencode: Error creating expression buffer.\n",
-			stderr);
-		return 1;
+		batch.data = (void *) name;
+		return batch_run(&batch, argv + optind, argc - optind) ? 1 : 0;
 	}
 
-	unsigned int max_line_len = 128;
-	char *buf = malloc(max_line_len * sizeof(char));
-	if (NULL == buf)
+	char *block = malloc(READ_BLOCK_SIZE * sizeof(char));
+	if (NULL == block)
 	{
-		tib_expr_destroy(&translated);
-		fputs("tibencode: Error allocating line buffer.\n", stderr);
+		fputs("tibencode: Error allocating read buffer.\n", stderr);
 		return 1;
 	}
 
-	int c = '\0';
-	unsigned int line_len = 0;
-	while (c != EOF)
-	{
-		for (; line_len < max_line_len - 1; ++line_len)
-		{
-			c = getchar();
-			if ('\n' == c || EOF == c)
-				break;
+	struct tib_fwriter writer;
+	FILE *out = stdout;
+	unsigned long nread = 0;
+	clock_t start = clock();
 
-			buf[line_len] = c;
-		}
-
-		if (max_line_len - 1 == line_len)
+	/* the header is patched once the length is known, so output that
+	 * cannot seek (or only appends) is spooled to a temporary file first */
+	if (fseek(stdout, 0, SEEK_CUR)
+			|| (fcntl(fileno(stdout), F_GETFL) & O_APPEND))
+	{
+		out = tmpfile();
+		if (!out)
 		{
-			char *old = buf;
-
-			max_line_len *= 2;
-			buf = realloc(buf, max_line_len * sizeof(char));
-			if (!buf)
-			{
-				free(old);
-				tib_errno = TIB_EALLOC;
-				goto end;
-			}
-
-			continue;
+			free(block);
+			fputs("tibencode: Error creating temporary file.\n",
+				stderr);
+			return 1;
 		}
+	}
 
-		buf[line_len] = '\0';
+	tib_errno = tib_fwriter_init(&writer, out, name, 0);
+	if (!tib_errno)
+	{
+		tib_errno = encode_stream(stdin, &writer, block, &nread);
 
-		struct tib_expr line;
-		tib_errno = tib_encode_str(&line, buf);
-		if (tib_errno)
-			goto end;
+		/* don't leave a partial program behind */
+		if (tib_errno && out == stdout)
+			discard_output(&writer);
+	}
 
-		tib_errno = tib_exprcat(&translated, &line);
-		tib_expr_destroy(&line);
-		if (tib_errno)
-			goto end;
+	if (!tib_errno && out != stdout)
+		tib_errno = copy_file(out, stdout, block);
 
-		if (c != EOF)
-		{
-			tib_errno = tib_expr_push(&translated, '\n');
-			if (tib_errno)
-				goto end;
-		}
+	if (out != stdout)
+		fclose(out);
 
-		line_len = 0;
-	}
-
- end:
-	free(buf);
-	tib_keyword_free();
+	free(block);
 
 	if (tib_errno)
 	{
-		tib_expr_destroy(&translated);
 		fprintf(stderr,
-			"tibencode: Error %d occurred while assembling.\n",
-			tib_errno);
+			"tibencode: Error %d occurred while processing. Wrote %lu characters.\n",
+			tib_errno, writer.written);
 		return 1;
 	}
 
-	tib_errno = tib_fwrite(stdout, &translated, &written);
-	tib_expr_destroy(&translated);
-	if (tib_errno)
+	if (stats)
 	{
+		double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
 		fprintf(stderr,
-			"tibencode: Error %d occurred while processing. Wrote %lu characters.\n",
-			tib_errno, written);
-		return 1;
+			"tibencode: Read %lu bytes, wrote %lu bytes in %.3f s (%.2f MB/s). Checksum %04X.\n",
+			nread, writer.written, secs,
+			secs > 0 ? nread / secs / 1e6 : 0.0, writer.checksum);
 	}
 
 	return 0;
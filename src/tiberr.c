@@ -15,4 +15,6 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-int tib_errno = 0;
+#include "tiberr.h"
+
+THREAD_LOCAL int tib_errno = 0;
@@ -36,6 +36,15 @@ enum tib_err
 	TIB_EOVER    = -14
 };
 
-extern int tib_errno;
+/* each thread has its own error code */
+#ifndef THREAD_LOCAL
+# ifdef __GNUC__
+#  define THREAD_LOCAL __thread
+# else
+#  define THREAD_LOCAL
+# endif
+#endif
+
+extern THREAD_LOCAL int tib_errno;
 
 #endif
@@ -15,93 +15,76 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <ctype.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "tibchar.h"
 #include "tiberr.h"
 #include "tibeval.h"
 #include "tibfunction.h"
-#include "tiblst.h"
+#include "tibkernel.h"
+#include "tibstack.h"
+#include "tibtoken.h"
 #include "tibvar.h"
+#include "util.h"
 
-enum math_operator_function_type
-{
-	T,
-	TT
-};
-
-struct math_operator
-{
-	union
-	{
-		TIB *(*t)(const TIB *);
-		TIB *(*tt)(const TIB *, const TIB *);
-	} func;
-
-	enum math_operator_function_type function_type;
-
-	int c;
-	int priority;
-};
-
-static const struct math_operator OPERATORS[] = {
-	{ {.t = tib_factorial }, T,  '!',             0},
-	{ {.t = tib_toradians }, T,  TIB_CHAR_DEGREE, 0},
-	{ {.tt = tib_pow },      TT, '^',             1},
-	{ {.tt = tib_mul },      TT, '*',             2},
-	{ {.tt = tib_div },      TT, '/',             2},
-	{ {.tt = tib_add },      TT, '+',             3},
-	{ {.tt = tib_sub },      TT, '-',             3}
-};
-
-#define NUM_MATH_OPERATORS (sizeof OPERATORS / sizeof (struct math_operator))
-#define LAST_PRIORITY 3
+#define IMPLICIT_PRIORITY 2
 
 static bool
 is_var_char(int c)
 {
-	return isupper(c) || TIB_CHAR_THETA == c;
+	return tib_isupper(c) || TIB_CHAR_THETA == c;
 }
 
 static bool
-needs_mult_common(int c)
+is_var_token(int c)
 {
-	return (isdigit(c) || is_var_char(c) || tib_is_var(c));
+	return is_var_char(c) || tib_is_var(c);
 }
 
 static bool
-needs_mult_right(int c)
+is_number_start(int c)
 {
-	return (needs_mult_common(c) || tib_is_func(c));
+	return tib_isdigit(c) || '.' == c || 'i' == c || TIB_CHAR_EPOW10 == c;
 }
 
 static bool
-needs_mult_left(int c)
+starts_operand(int c)
 {
-	return (needs_mult_common(c) || ')' == c);
+	return is_number_start(c) || is_var_token(c) || tib_is_func(c)
+		|| TIB_CHAR_LUSER == c;
 }
 
-bool
-is_sign_operator(int c)
+static bool
+is_list_name_char(int c, bool first)
 {
-	return ('+' == c || '-' == c);
+	return is_var_char(c) || (!first && tib_isdigit(c));
 }
 
-static const struct math_operator *
-get_math_operator(int c)
+/* the length of the user list name at beg, or 0 if there is none */
+static int
+list_name_len(const struct tib_expr *expr, int beg, int end)
 {
-	for (unsigned int i = 0; i < NUM_MATH_OPERATORS; ++i)
-		if (OPERATORS[i].c == c)
-			return &OPERATORS[i];
+	int len = 0;
 
-	return NULL;
+	while (beg + len < end && len < TIB_LIST_NAME_MAX
+		&& is_list_name_char(expr->data[beg + len], 0 == len))
+		++len;
+
+	return len;
+}
+
+bool
+is_sign_operator(int c)
+{
+	return ('+' == c || '-' == c);
 }
 
 bool
 is_math_operator(int c)
 {
-	return get_math_operator(c) != NULL;
+	return tib_token(c)->arity != 0;
 }
 
 unsigned int
@@ -129,414 +112,1455 @@ contains_i(const struct tib_expr *expr)
 	return false;
 }
 
+/* build with -DTIB_DEBUG_IR to trace compilation on stderr */
+#ifdef TIB_DEBUG_IR
+# define DUMP_IR(S,C)						\
+	(fprintf(stderr, "%s:\n", (S)), tib_code_dump((C), stderr))
+#else
+# define DUMP_IR(S,C) ((void) 0)
+#endif
+
+struct parser
+{
+	const struct tib_expr *expr;
+	struct tib_code *code;
+
+	int pos;
+	int end;
+};
+
 static int
-replace_epow10(struct tib_expr *expr)
+peek(const struct parser *p)
 {
-	int i;
+	if (p->pos < p->end)
+		return p->expr->data[p->pos];
 
-	tib_expr_foreach(expr, i)
+	return EOF;
+}
+
+static int
+code_push(struct tib_code *code, const struct tib_op *op)
+{
+	if (code->len == code->bufsize)
 	{
-		if (TIB_CHAR_EPOW10 == expr->data[i])
-		{
-			expr->data[i++] = '*';
+		struct tib_op *old = code->data;
+		int bufsize = code->bufsize ? code->bufsize * 2 : 16;
 
-			const char *s = "10^";
-			for (; *s != '\0'; ++s, ++i)
-			{
-				int rc = tib_expr_insert(expr, i, *s);
-				if (rc)
-					return rc;
-			}
+		if (code->arena)
+			code->data = tib_arena_realloc(code->arena, code->data,
+					code->bufsize * sizeof(struct tib_op),
+					bufsize * sizeof(struct tib_op));
+		else
+			code->data = realloc(code->data,
+					bufsize * sizeof(struct tib_op));
+
+		if (!code->data)
+		{
+			code->data = old;
+			return TIB_EALLOC;
 		}
+
+		code->bufsize = bufsize;
 	}
 
+	code->data[code->len++] = *op;
 	return 0;
 }
 
-static TIB *
-single_eval(const struct tib_expr *expr)
+static int
+emit(struct parser *p, enum tib_op_type type, int c)
 {
-	int len = expr->len;
+	struct tib_op op = { .type = type, .c = c };
+	return code_push(p->code, &op);
+}
+
+static int
+emit_number(struct parser *p, double real, double imaginary)
+{
+	struct tib_op op = { .type = TIB_OP_NUM };
+	GSL_SET_COMPLEX(&op.value.number, real, imaginary);
 
-	if (0 == len)
-		return tib_empty();
+	return code_push(p->code, &op);
+}
+
+static int
+emit_list(struct parser *p, enum tib_op_type type, int beg, int len)
+{
+	struct tib_op op = { .type = type, .c = TIB_CHAR_LUSER };
+	op.value.name.beg = beg;
+	op.value.name.len = len;
+
+	return code_push(p->code, &op);
+}
+
+static int
+parse_level(struct parser *p, int priority);
 
-	if (1 == len
-		&& (is_var_char(expr->data[0]) || tib_is_var(expr->data[0])))
-		return tib_var_get(expr->data[0]);
+static int
+parse_number(struct parser *p)
+{
+	const tib_Char *data = p->expr->data;
+	int beg = p->pos, i = beg, dots = 0;
 
-	int func = tib_eval_surrounded(expr);
-	if (func)
+	while (i < p->end && (tib_isdigit(data[i]) || '.' == data[i]))
+		if ('.' == data[i++])
+			++dots;
+
+	int mantissa_end = i, exp_beg = i;
+	if (i < p->end && TIB_CHAR_EPOW10 == data[i])
 	{
-		struct tib_expr temp;
-		tib_subexpr(&temp, expr, 1, len - 1);
-		return tib_call(func, &temp);
+		exp_beg = ++i;
+
+		if (i < p->end && is_sign_operator(data[i]))
+			++i;
+
+		while (i < p->end && tib_isdigit(data[i]))
+			++i;
+
+		if (i == exp_beg || !tib_isdigit(data[i - 1]))
+			return TIB_ESYNTAX;
 	}
 
-	if (tib_eval_isnum(expr))
+	int exp_end = i;
+	bool imaginary = (i < p->end && 'i' == data[i]);
+	if (imaginary)
+		++i;
+
+	if (dots > 1 || (mantissa_end - beg == dots && dots))
+		return TIB_ESYNTAX;
+
+	char s[exp_end - beg + 3];
+	int len = 0;
+
+	if (beg == mantissa_end)
+		s[len++] = '1';
+
+	for (int j = beg; j < mantissa_end; ++j)
+		s[len++] = data[j];
+
+	if (exp_beg != mantissa_end)
 	{
-		gsl_complex z;
-		tib_errno = tib_expr_parse_complex(expr, &z);
-		return tib_errno ? NULL : tib_new_complex(GSL_REAL(z),
-							GSL_IMAG(z));
+		s[len++] = 'e';
+
+		for (int j = exp_beg; j < exp_end; ++j)
+			s[len++] = data[j];
 	}
 
-	if (tib_eval_isstr(expr))
-	{
-		char *s = tib_expr_tostr(expr);
-		if (NULL == s)
-			return NULL;
+	s[len] = '\0';
 
-		TIB *temp = tib_new_str(s);
-		free(s);
+	double value = strtod(s, NULL);
+	p->pos = i;
 
-		return temp;
-	}
+	if (imaginary)
+		return emit_number(p, 0, value);
 
-	tib_errno = TIB_ESYNTAX;
-	return NULL;
+	return emit_number(p, value, 0);
 }
 
-TIB *
-tib_eval(const struct tib_expr *in)
+/* where string literals are rendered before being copied into an
+ * arena; released by tib_eval_free */
+static THREAD_LOCAL char *string_scratch = NULL;
+static THREAD_LOCAL size_t string_scratch_size = 0;
+
+static int
+parse_string(struct parser *p)
 {
-	int i;
+	int end = p->pos + 1;
 
-	if (0 == in->len)
-		return tib_empty();
+	while (end < p->end && p->expr->data[end] != '"')
+		++end;
 
-	/* check for store operator */
-	i = tib_expr_indexof(in, TIB_CHAR_STO);
-	if (i >= 0)
+	if (end < p->end)
+		++end;
+
+	struct tib_expr sub;
+	tib_subexpr(&sub, p->expr, p->pos, end);
+	if (!tib_eval_isstr(&sub))
+		return TIB_ESYNTAX;
+
+	struct tib_op op = { .type = TIB_OP_STR };
+	if (p->code->arena)
 	{
-		if (i != in->len - 2 || 0 == i)
-		{
-			tib_errno = TIB_ESYNTAX;
-			return NULL;
-		}
+		size_t len;
 
-		int c = in->data[i + 1];
-		if (!is_var_char(c))
-		{
-			tib_errno = TIB_ESYNTAX;
-			return NULL;
-		}
+		int rc = tib_expr_tostr_buf(&sub, tib_special_char_text,
+					&string_scratch, &string_scratch_size,
+					&len);
+		if (rc)
+			return rc;
 
-		struct tib_expr e;
-		tib_subexpr(&e, in, 0, i);
+		op.value.string = tib_arena_alloc(p->code->arena, len + 1);
+		if (!op.value.string)
+			return TIB_EALLOC;
 
-		TIB *stoval = tib_eval(&e);
-		if (NULL == stoval)
-			return NULL;
+		memcpy(op.value.string, string_scratch, len + 1);
+	}
+	else
+	{
+		op.value.string = tib_expr_tostr(&sub);
+		if (!op.value.string)
+			return tib_errno;
+	}
 
-		tib_errno = tib_var_set(c, stoval);
-		if (tib_errno)
-		{
-			tib_decref(stoval);
-			return NULL;
-		}
+	int rc = code_push(p->code, &op);
+	if (rc && !p->code->arena)
+		free(op.value.string);
+	else if (!rc)
+		p->pos = end;
+
+	return rc;
+}
+
+/* finds the comma or closing parenthesis ending the argument at beg */
+static int
+arg_end(const tib_Char *data, int beg, int end)
+{
+	int count = 0;
+	bool str = false;
+
+	for (; beg < end; ++beg)
+	{
+		int c = data[beg];
 
-		return stoval;
+		if ('"' == c)
+			str = !str;
+		else if (str)
+			continue;
+		else if (tib_is_func(c))
+			++count;
+		else if (')' == c)
+			--count;
+		else if (',' == c && 0 == count)
+			break;
 	}
 
-	struct tib_expr expr = {.bufsize = 0 };
-	tib_errno = tib_exprcpy(&expr, in);
-	if (tib_errno)
-		return NULL;
+	return beg;
+}
+
+/* compiles each argument in [beg, end) in turn, leaving their values
+ * on the stack for the call */
+static int
+parse_args(struct parser *p, int key, int beg, int end)
+{
+	const struct tib_function *func = tib_function(key);
+	int outer_end = p->end, argc = 0, rc = 0;
 
-	// check for sign operator at the beginning of number
-	if (expr.len > 0 && ('-' == expr.data[0] || '+' == expr.data[0]))
+	p->pos = beg;
+	while (!rc)
 	{
-		tib_errno = tib_expr_insert(&expr, 0, '0');
-		if (tib_errno)
+		if (++argc > func->max_args)
 		{
-			tib_expr_destroy(&expr);
-			return NULL;
+			rc = TIB_EARGNUM;
+			break;
 		}
-	}
 
-	// check for implicit closing parentheses and close them
-	tib_errno = tib_eval_close_parens(&expr);
-	if (tib_errno)
-	{
-		tib_expr_destroy(&expr);
-		return NULL;
+		p->end = arg_end(p->expr->data, p->pos, end);
+
+		rc = parse_level(p, TIB_LAST_PRIORITY);
+		if (!rc && p->pos != p->end)
+			rc = TIB_ESYNTAX;
+
+		if (rc || p->end == end)
+			break;
+
+		p->pos = p->end + 1;
 	}
 
-	// replace power of 10 E character with "*10^"
-	tib_errno = replace_epow10(&expr);
-	if (tib_errno)
+	p->end = outer_end;
+
+	if (!rc && argc < func->min_args)
+		rc = TIB_EARGNUM;
+
+	if (!rc)
 	{
-		tib_expr_destroy(&expr);
-		return NULL;
+		struct tib_op op = { .type = TIB_OP_CALL, .c = key };
+		op.value.argc = argc;
+
+		rc = code_push(p->code, &op);
 	}
 
-	// add multiplication operators between implicit multiplications
-	bool add = true;
-	tib_expr_foreach(&expr, i)
+	return rc;
+}
+
+static int
+parse_call(struct parser *p)
+{
+	const tib_Char *data = p->expr->data;
+	int key = data[p->pos], beg = p->pos + 1, end, count = 1, rc;
+	bool str = false;
+
+	for (end = beg; end < p->end; ++end)
 	{
-		int c = expr.data[i];
+		int c = data[end];
 
 		if ('"' == c)
-		{
-			add = !add; // don't change anything inside a string
-		}
-		else if (add)
-		{
-			if (is_var_char(c) || tib_is_var(c))
-			{
-				if (i > 0 && needs_mult_left(expr.data[i - 1]))
-					tib_errno = tib_expr_insert(&expr,
-								i++, '*');
-
-				if (!tib_errno && i < expr.len - 1
-					&& needs_mult_right(expr.data[i + 1]))
-					tib_errno = tib_expr_insert(&expr,
-								++i, '*');
-			}
-			else if (i > 0 && i < expr.len - 1)
-			{
-				if (tib_is_func(c)
-					&& needs_mult_left(expr.data[i - 1]))
-					tib_errno = tib_expr_insert(&expr,
-								i++, '*');
-				else if (')' == c
-					&& needs_mult_right(expr.data[i + 1]))
-					tib_errno = tib_expr_insert(&expr,
-								++i, '*');
-			}
-
-			if (tib_errno)
-			{
-				tib_expr_destroy(&expr);
-				return NULL;
-			}
-		}
+			str = !str;
+		else if (str)
+			continue;
+		else if (tib_is_func(c))
+			++count;
+		else if (')' == c && --count == 0)
+			break;
 	}
 
-	// this is temp storage for internally-resolved portions
-	struct tib_lst *resolved = tib_new_lst();
-	if (!resolved)
+	if (end == beg)
 	{
-		tib_expr_destroy(&expr);
-		tib_errno = TIB_EALLOC;
-		return NULL;
+		rc = TIB_ESYNTAX;
 	}
+	else if ('(' == key)
+	{
+		int outer_end = p->end;
 
-	// this is to remember the operations to be executed
-	struct tib_expr calc;
-	tib_errno = tib_expr_init(&calc);
-	if (tib_errno)
+		p->pos = beg;
+		p->end = end;
+
+		rc = parse_level(p, TIB_LAST_PRIORITY);
+		if (!rc && p->pos != end)
+			rc = TIB_ESYNTAX;
+
+		p->end = outer_end;
+	}
+	else
 	{
-		tib_expr_destroy(&expr);
-		tib_free_lst(resolved);
-		return NULL;
+		rc = parse_args(p, key, beg, end);
 	}
 
-	// resolve operand expressions, and store the values for later
-	int beg = 0, numpar = 0;
-	add = true;
-	tib_expr_foreach(&expr, i)
-	{
-		int c = expr.data[i];
+	// the closing parenthesis is implied at the end of the expression
+	p->pos = (end < p->end) ? end + 1 : end;
+	return rc;
+}
 
-		if ('"' == c)
-		{
-			add = !add;
-			continue;
-		}
+static int
+parse_user_list(struct parser *p)
+{
+	int beg = ++p->pos;
+	int len = list_name_len(p->expr, beg, p->end);
 
-		if (!add)
-			continue;
+	if (!len)
+		return TIB_ESYNTAX;
 
-		if (tib_is_func(c))
-		{
-			++numpar;
-		}
-		else if (')' == c)
-		{
-			if (0 == numpar)
-			{
-				tib_errno = TIB_ESYNTAX;
-				break;
-			}
+	p->pos += len;
+	return emit_list(p, TIB_OP_VAR, beg, len);
+}
 
-			--numpar;
-		}
+static int
+parse_operand(struct parser *p)
+{
+	int rc, c = peek(p);
+
+	if (is_sign_operator(c))
+	{
+		++p->pos;
 
-		const struct math_operator *oper;
-		if (0 == numpar && (oper = get_math_operator(c)) != NULL)
+		if ('-' == c)
 		{
-			struct tib_expr sub;
-			tib_subexpr(&sub, &expr, beg, i);
+			rc = emit_number(p, 0, 0);
+			if (rc)
+				return rc;
+		}
 
-			TIB *part = single_eval(&sub);
-			if (!part)
-				break;
+		rc = parse_level(p, 1);
+		if (!rc && '-' == c)
+			rc = emit(p, TIB_OP_BINARY, c);
 
-			if (T == oper->function_type)
-			{
-				do
-				{
-					TIB *temp = oper->func.t(part);
-					tib_decref(part);
-					if (!temp)
-						break;
-
-					part = temp;
-				} while (++i < expr.len
-					&& (oper = get_math_operator(expr.data[i])) != NULL
-					&& T == oper->function_type);
-
-				if (tib_errno)
-					break;
-
-				tib_errno = tib_lst_push(resolved, part);
-				tib_decref(part);
-				if (tib_errno)
-					break;
-
-				if (i < expr.len)
-				{
-					c = expr.data[i];
-
-					if (is_math_operator(c))
-					{
-						tib_errno = tib_expr_push(&calc,
-									c);
-						if (tib_errno)
-							break;
-
-						++i;
-					}
-					else
-					{
-						tib_errno = tib_expr_push(&calc,
-									'*');
-						if (tib_errno)
-							break;
-					}
-
-					beg = i;
-				}
-			}
-			else
-			{
-				tib_errno = tib_lst_push(resolved, part);
-				tib_decref(part);
-				if (tib_errno)
-					break;
+		return rc;
+	}
 
-				tib_errno = tib_expr_push(&calc, c);
-				if (tib_errno)
-					break;
+	if (is_number_start(c))
+	{
+		rc = parse_number(p);
+	}
+	else if ('"' == c)
+	{
+		rc = parse_string(p);
+	}
+	else if (tib_is_func(c))
+	{
+		rc = parse_call(p);
+	}
+	else if (is_var_token(c))
+	{
+		++p->pos;
+		rc = emit(p, TIB_OP_VAR, c);
+	}
+	else if (TIB_CHAR_LUSER == c)
+	{
+		rc = parse_user_list(p);
+	}
+	else
+	{
+		rc = TIB_ESYNTAX;
+	}
 
-				beg = i + 1;
-			}
-		}
+	while (!rc && 1 == tib_token(c = peek(p))->arity)
+	{
+		++p->pos;
+		rc = emit(p, TIB_OP_UNARY, c);
 	}
 
-	if (!tib_errno)
+	return rc;
+}
+
+static int
+parse_level(struct parser *p, int priority)
+{
+	if (0 == priority)
+		return parse_operand(p);
+
+	int rc = parse_level(p, priority - 1);
+	while (!rc && p->pos < p->end)
 	{
-		const struct math_operator *oper;
+		int c = peek(p);
+		const struct tib_token *token = tib_token(c);
 
-		if (tib_lst_len(resolved) == 0)
+		if (2 == token->arity)
 		{
-			TIB *temp = single_eval(&expr);
-			if (!temp)
-				goto end;
+			if (token->priority != priority)
+				break;
 
-			tib_errno = tib_lst_push(resolved, temp);
-			tib_decref(temp);
-			if (tib_errno)
-				goto end;
+			++p->pos;
 		}
-		else if (NULL ==
-			(oper = get_math_operator(expr.data[expr.len - 1]))
-			|| oper->function_type != T)
+		else if (IMPLICIT_PRIORITY == priority && starts_operand(c))
 		{
-			struct tib_expr sub;
-			tib_subexpr(&sub, &expr, beg, i);
-
-			TIB *temp = single_eval(&sub);
-			if (!temp)
-				goto end;
-
-			tib_errno = tib_lst_push(resolved, temp);
-			tib_decref(temp);
-			if (tib_errno)
-				goto end;
+			c = '*';
+		}
+		else
+		{
+			break;
 		}
 
-		if (tib_lst_len(resolved) != calc.len + 1)
-			tib_errno = TIB_ESYNTAX;
+		rc = parse_level(p, priority - 1);
+		if (!rc)
+			rc = emit(p, TIB_OP_BINARY, c);
 	}
 
-	tib_expr_destroy(&expr);
-
-	if (tib_errno)
-		goto end;
+	return rc;
+}
 
-	for (int priority = 1; priority <= LAST_PRIORITY; ++priority)
-	{
-		for (i = 0; i < calc.len; ++i)
-		{
-			const struct math_operator *oper =
-			    get_math_operator(calc.data[i]);
-			if (oper->priority != priority)
-				continue;
+static int
+copy_src(struct tib_code *dest, const struct tib_expr *expr)
+{
+	dest->src.bufsize = 0;
 
-			TIB *t;
-			unsigned int num_operands;
-			switch (oper->function_type)
-			{
-			case TT:
-				t = oper->func.tt(tib_lst_ref(resolved, i),
-						tib_lst_ref(resolved, i + 1));
-				if (!t)
-					goto end;
+	if (!dest->arena)
+		return tib_exprcpy(&dest->src, expr);
 
-				num_operands = 2;
-				break;
+	dest->src.data = tib_arena_alloc(dest->arena,
+					(expr->len + 1) * sizeof(tib_Char));
+	if (!dest->src.data)
+		return TIB_EALLOC;
 
-			default:
-				tib_errno = TIB_ESYNTAX;
-				goto end;
-			}
+	memcpy(dest->src.data, expr->data, expr->len * sizeof(tib_Char));
+	dest->src.len = expr->len;
+	return 0;
+}
 
-			for (unsigned int _ = 0; _ < num_operands; ++_)
-				tib_lst_remove(resolved, i);
+static bool
+constant_value(int key, gsl_complex *out)
+{
+	if (!tib_var_is_constant(key) || !tib_is_var(key))
+		return false;
 
-			tib_errno = tib_lst_insert(resolved, t, i);
-			tib_decref(t);
+	TIB *t = tib_var_get(key);
+	bool number = (TIB_TYPE_COMPLEX == tib_type(t));
+	if (number)
+		*out = tib_complex_value(t);
 
-			if (tib_errno)
-				goto end;
+	tib_decref(t);
+	return number;
+}
 
-			tib_expr_delete(&calc, i--);
-		}
-	}
+/* Operands end just before their operator, and a constant operand is
+ * always a single NUM op, so constant subexpressions can be collapsed
+ * in one pass by looking back from each operator. Operations that
+ * would fail are left for run time to report. */
+static void
+fold_constants(struct tib_code *code)
+{
+	struct tib_op *data = code->data;
+	int len = 0;
 
- end:
-	tib_expr_destroy(&calc);
+	code->constants_version = 0;
 
-	TIB *out = NULL;
-	if (!tib_errno)
+	for (int i = 0; i < code->len; ++i)
 	{
-		if (tib_lst_len(resolved) != 1)
+		struct tib_op op = data[i];
+		const struct tib_token *token = tib_token(op.c);
+		gsl_complex z;
+
+		if (TIB_OP_VAR == op.type && constant_value(op.c, &z))
 		{
-			tib_errno = TIB_ESYNTAX;
+			op.type = TIB_OP_NUM;
+			op.value.number = z;
+			code->constants_version = tib_var_constants_version();
 		}
-		else
+		else if (TIB_OP_UNARY == op.type && token->scalar.t
+			&& len >= 1 && TIB_OP_NUM == data[len - 1].type
+			&& !token->scalar.t(&z, data[len - 1].value.number))
 		{
-			out = tib_lst_ref(resolved, 0);
-			tib_incref(out);
+			data[len - 1].value.number = z;
+			continue;
+		}
+		else if (TIB_OP_BINARY == op.type && token->scalar.tt
+			&& len >= 2 && TIB_OP_NUM == data[len - 1].type
+			&& TIB_OP_NUM == data[len - 2].type
+			&& !token->scalar.tt(&z, data[len - 2].value.number,
+					data[len - 1].value.number))
+		{
+			data[len - 2].value.number = z;
+			--len;
+			continue;
 		}
+
+		data[len++] = op;
 	}
 
-	tib_free_lst(resolved);
+	code->len = len;
+}
 
-	return out;
+static enum tib_kernel_op
+kernel_op(int c)
+{
+	switch (c)
+	{
+	case '+':
+		return TIB_KERNEL_ADD;
+
+	case '-':
+		return TIB_KERNEL_SUB;
+
+	case '*':
+		return TIB_KERNEL_MUL;
+
+	default:
+		return TIB_KERNEL_DIV;
+	}
+}
+
+static bool
+is_fusable_op(const struct tib_op *op)
+{
+	if (TIB_OP_BINARY != op->type)
+		return false;
+
+	return '+' == op->c || '-' == op->c || '*' == op->c || '/' == op->c;
+}
+
+/* Fusing needs scratch space in proportion to the code length, which
+ * can be far too much for the C stack; beyond this it goes on the heap. */
+#define FUSE_LOCAL_LEN 64
+
+/* an operand on the stack of find_fused, covering ops [start, end) */
+struct fuse_node
+{
+	int start;
+	int end;
+	int binops;
+	int vars;
+	bool ok;
+};
+
+/* A single operator is already a single pass over its operands, so
+ * only runs of two or more are worth marking. */
+static void
+close_run(const struct fuse_node *node, int *runs)
+{
+	if (node->ok && node->binops >= 2 && node->vars)
+		runs[node->start] = node->end - node->start;
+}
+
+/* Finds the largest subexpressions made only of fusable operators over
+ * numbers and variables, and records their lengths in runs by first op.
+ * stack needs room for code->len nodes. Returns false if nothing was
+ * found. */
+static bool
+find_fused(const struct tib_code *code, struct fuse_node *stack, int *runs)
+{
+	int len = 0;
+	bool found = false;
+
+	for (int i = 0; i < code->len; ++i)
+	{
+		const struct tib_op *op = &code->data[i];
+		struct fuse_node node = { i, i + 1, 0, 0, false };
+		int pops;
+
+		switch (op->type)
+		{
+		case TIB_OP_NUM:
+		case TIB_OP_VAR:
+			node.vars = (TIB_OP_VAR == op->type);
+			node.ok = true;
+			pops = 0;
+			break;
+
+		case TIB_OP_CALL:
+			pops = op->value.argc;
+			break;
+
+		case TIB_OP_UNARY:
+			pops = 1;
+			break;
+
+		case TIB_OP_BINARY:
+			pops = 2;
+			break;
+
+		case TIB_OP_STR:
+			pops = 0;
+			break;
+
+		default:
+			continue;
+		}
+
+		if (pops > len)
+			return false;
+
+		len -= pops;
+		if (pops)
+			node.start = stack[len].start;
+
+		if (2 == pops && is_fusable_op(op)
+			&& stack[len].ok && stack[len + 1].ok)
+		{
+			node.binops = stack[len].binops
+				+ stack[len + 1].binops + 1;
+			node.vars = stack[len].vars + stack[len + 1].vars;
+			node.ok = true;
+		}
+		else
+		{
+			for (int j = 0; j < pops; ++j)
+				close_run(&stack[len + j], runs);
+		}
+
+		stack[len++] = node;
+	}
+
+	for (int j = 0; j < len; ++j)
+		close_run(&stack[j], runs);
+
+	for (int i = 0; i < code->len; ++i)
+		if (runs[i])
+			found = true;
+
+	return found;
+}
+
+/* puts a FUSE op in front of each run found by find_fused */
+static int
+mark_fused(struct tib_code *code)
+{
+	struct fuse_node local_stack[FUSE_LOCAL_LEN], *stack = local_stack;
+	int local_runs[FUSE_LOCAL_LEN], *runs = local_runs;
+
+	if (code->len > FUSE_LOCAL_LEN)
+	{
+		stack = malloc(code->len * sizeof(struct fuse_node));
+		runs = malloc(code->len * sizeof(int));
+
+		if (!stack || !runs)
+		{
+			free(stack);
+			free(runs);
+			return TIB_EALLOC;
+		}
+	}
+
+	memset(runs, 0, code->len * sizeof(int));
+
+	int rc = 0;
+	if (!find_fused(code, stack, runs))
+		goto end;
+
+	struct tib_code marked = *code;
+	marked.data = NULL;
+	marked.len = 0;
+	marked.bufsize = 0;
+
+	for (int i = 0; i < code->len && !rc; ++i)
+	{
+		if (runs[i])
+		{
+			struct tib_op op = { .type = TIB_OP_FUSE };
+			op.value.len = runs[i];
+
+			rc = code_push(&marked, &op);
+			if (rc)
+				break;
+		}
+
+		rc = code_push(&marked, &code->data[i]);
+	}
+
+	if (rc)
+	{
+		if (!marked.arena)
+			free(marked.data);
+
+		goto end;
+	}
+
+	if (!code->arena)
+		free(code->data);
+
+	code->data = marked.data;
+	code->len = marked.len;
+	code->bufsize = marked.bufsize;
+
+ end:
+	if (stack != local_stack)
+	{
+		free(stack);
+		free(runs);
+	}
+
+	return rc;
+}
+
+int
+tib_compile(struct tib_code *dest, const struct tib_expr *expr)
+{
+	return tib_compile_in(dest, expr, NULL);
+}
+
+int
+tib_compile_in(struct tib_code *dest, const struct tib_expr *expr,
+		struct tib_arena *arena)
+{
+	dest->data = NULL;
+	dest->len = 0;
+	dest->bufsize = 0;
+	dest->arena = arena;
+	dest->constants_version = 0;
+
+	int rc = copy_src(dest, expr);
+	if (rc)
+		return rc;
+
+	struct parser p = {
+		.expr = &dest->src,
+		.code = dest,
+		.pos = 0,
+		.end = expr->len
+	};
+
+	/* check for store operator */
+	int sto = tib_expr_indexof(expr, TIB_CHAR_STO);
+	bool sto_list = false;
+	if (sto >= 0)
+	{
+		int target = expr->len - sto - 1;
+
+		sto_list = target > 1 && TIB_CHAR_LUSER == expr->data[sto + 1]
+			&& list_name_len(expr, sto + 2, expr->len) == target - 1;
+
+		if (0 == sto || !(sto_list || (1 == target
+						&& is_var_char(expr->data[sto + 1]))))
+		{
+			rc = TIB_ESYNTAX;
+			goto end;
+		}
+
+		p.end = sto;
+	}
+
+	if (p.end > 0)
+	{
+		rc = parse_level(&p, TIB_LAST_PRIORITY);
+		if (!rc && p.pos != p.end)
+			rc = TIB_ESYNTAX;
+	}
+
+	if (!rc && sto_list)
+		rc = emit_list(&p, TIB_OP_STO, sto + 2, expr->len - sto - 2);
+	else if (!rc && sto >= 0)
+		rc = emit(&p, TIB_OP_STO, expr->data[sto + 1]);
+
+	if (!rc)
+	{
+		DUMP_IR("parsed", dest);
+		fold_constants(dest);
+		DUMP_IR("folded", dest);
+
+		rc = mark_fused(dest);
+		if (!rc)
+			DUMP_IR("fused", dest);
+	}
+
+ end:
+	if (rc)
+		tib_code_destroy(dest);
+
+	return rc;
+}
+
+static void
+dump_token(int c, FILE *f)
+{
+	const char *special = tib_special_char_text(c);
+
+	if (special)
+		fputs(special, f);
+	else
+		fputc(c, f);
+}
+
+void
+tib_code_dump(const struct tib_code *code, FILE *f)
+{
+	static const char *names[] = {
+		[TIB_OP_NUM] = "num",
+		[TIB_OP_STR] = "str",
+		[TIB_OP_VAR] = "var",
+		[TIB_OP_CALL] = "call",
+		[TIB_OP_UNARY] = "unary",
+		[TIB_OP_BINARY] = "binary",
+		[TIB_OP_STO] = "sto",
+		[TIB_OP_FUSE] = "fuse"
+	};
+
+	for (int i = 0; i < code->len; ++i)
+	{
+		const struct tib_op *op = &code->data[i];
+
+		fprintf(f, "%4d  %-6s ", i, names[op->type]);
+
+		switch (op->type)
+		{
+		case TIB_OP_NUM:
+			fprintf(f, "%g%+gi", GSL_REAL(op->value.number),
+				GSL_IMAG(op->value.number));
+			break;
+
+		case TIB_OP_STR:
+			fputs(op->value.string, f);
+			break;
+
+		case TIB_OP_CALL:
+			dump_token(op->c, f);
+			fprintf(f, " %d", op->value.argc);
+			break;
+
+		case TIB_OP_FUSE:
+			fprintf(f, "%d", op->value.len);
+			break;
+
+		case TIB_OP_VAR:
+		case TIB_OP_STO:
+			if (TIB_CHAR_LUSER != op->c)
+			{
+				dump_token(op->c, f);
+				break;
+			}
+
+			fputs("list ", f);
+			for (int j = 0; j < op->value.name.len; ++j)
+				dump_token(code->src.data[op->value.name.beg + j],
+					f);
+			break;
+
+		default:
+			dump_token(op->c, f);
+			break;
+		}
+
+		fputc('\n', f);
+	}
+}
+
+void
+tib_code_destroy(struct tib_code *self)
+{
+	if (!self->arena)
+	{
+		for (int i = 0; i < self->len; ++i)
+			if (TIB_OP_STR == self->data[i].type)
+				free(self->data[i].value.string);
+
+		free(self->data);
+		tib_expr_destroy(&self->src);
+	}
+
+	self->data = NULL;
+	self->len = 0;
+	self->bufsize = 0;
+}
+
+static struct tib_expr
+list_name(const struct tib_code *code, const struct tib_op *op)
+{
+	struct tib_expr name;
+
+	tib_subexpr(&name, &code->src, op->value.name.beg,
+		op->value.name.beg + op->value.name.len);
+	return name;
+}
+
+/* returns a new reference to the variable named by a VAR op */
+static TIB *
+var_get(const struct tib_code *code, const struct tib_op *op)
+{
+	if (TIB_CHAR_LUSER != op->c)
+		return tib_var_get(op->c);
+
+	struct tib_expr name = list_name(code, op);
+	return tib_var_list_get(&name);
+}
+
+static int
+var_set(const struct tib_code *code, const struct tib_op *op, TIB *value)
+{
+	if (TIB_CHAR_LUSER != op->c)
+		return tib_var_set(op->c, value);
+
+	struct tib_expr name = list_name(code, op);
+	return tib_var_list_set(&name, value);
+}
+
+static int
+eval_unary(struct tib_stack *stack, int c)
+{
+	const struct tib_token *token = tib_token(c);
+	tib_Value operand = tib_stack_pop(stack);
+	gsl_complex z;
+	TIB scratch;
+	int rc;
+
+	if (!operand.boxed && token->scalar.t)
+	{
+		rc = token->scalar.t(&z, operand.number);
+		if (rc)
+			return rc;
+
+		return tib_stack_push_complex(stack, z);
+	}
+
+	TIB *t = token->oper.t(tib_value_view(&operand, &scratch));
+	tib_value_release(&operand);
+	if (!t)
+		return tib_errno ? tib_errno : TIB_ESYNTAX;
+
+	rc = tib_stack_push(stack, t);
+	if (rc)
+		tib_decref(t);
+
+	return rc;
+}
+
+static int
+eval_binary(struct tib_stack *stack, int c)
+{
+	const struct tib_token *token = tib_token(c);
+	tib_Value rhs = tib_stack_pop(stack);
+	tib_Value lhs = tib_stack_pop(stack);
+	TIB lhs_scratch, rhs_scratch;
+	gsl_complex z;
+	int rc;
+
+	if (!lhs.boxed && !rhs.boxed && token->scalar.tt)
+	{
+		rc = token->scalar.tt(&z, lhs.number, rhs.number);
+		if (rc)
+			return rc;
+
+		return tib_stack_push_complex(stack, z);
+	}
+
+	TIB *t1 = tib_value_view(&lhs, &lhs_scratch);
+	TIB *t2 = tib_value_view(&rhs, &rhs_scratch);
+	TIB *t;
+
+	/* intermediates are handed over so their buffers can be reused */
+	if (token->consume)
+	{
+		t = token->consume(t1, t2);
+	}
+	else
+	{
+		t = token->oper.tt(t1, t2);
+		tib_value_release(&lhs);
+		tib_value_release(&rhs);
+	}
+
+	if (!t)
+		return tib_errno ? tib_errno : TIB_ESYNTAX;
+
+	rc = tib_stack_push(stack, t);
+	if (rc)
+		tib_decref(t);
+
+	return rc;
+}
+
+static int
+eval_call(struct tib_stack *stack, int c, int argc)
+{
+	int base = tib_stack_len(stack) - argc;
+	TIB scratch[TIB_MAX_ARGS], *args[TIB_MAX_ARGS];
+	int rc;
+
+	for (int i = 0; i < argc; ++i)
+		args[i] = tib_value_view(tib_stack_ref(stack, base + i),
+					&scratch[i]);
+
+	TIB *t = tib_call(c, args, argc);
+
+	for (int i = 0; i < argc; ++i)
+	{
+		tib_Value v = tib_stack_pop(stack);
+		tib_value_release(&v);
+	}
+
+	if (!t)
+		return tib_errno ? tib_errno : TIB_ESYNTAX;
+
+	rc = tib_stack_push(stack, t);
+	if (rc)
+		tib_decref(t);
+
+	return rc;
+}
+
+#define FUSE_CHUNK 256
+#define FUSE_DEPTH 8
+
+/* An operand of a fused run: a chunk of a list, or a single number.
+ * real says whether the list or number would be taken as real-only by
+ * the operators, so each step rounds exactly as it would unfused. */
+struct fuse_operand
+{
+	const double *data;
+	gsl_complex number;
+	bool real;
+};
+
+/* Looks up the variables of a fused run. Returns the common length of
+ * the lists among them, or 0 if the run doesn't suit fusing: no lists,
+ * lists of different lengths, other types, or a stack deeper than
+ * FUSE_DEPTH. */
+static size_t
+fuse_leaves(const struct tib_code *code, const struct tib_op *ops, int len,
+	TIB **leaves)
+{
+	size_t n = 0;
+	int depth = 0;
+
+	for (int i = 0; i < len; ++i)
+	{
+		const struct tib_op *op = &ops[i];
+
+		if (TIB_OP_BINARY == op->type)
+		{
+			--depth;
+			continue;
+		}
+
+		if (++depth > FUSE_DEPTH)
+			return 0;
+
+		if (TIB_OP_NUM == op->type)
+			continue;
+
+		TIB *t = leaves[i] = var_get(code, op);
+		if (NULL == t)
+			return 0;
+
+		if (TIB_TYPE_LIST == t->type)
+		{
+			size_t size = tib_list_size(t);
+			if (0 == size || (n && size != n))
+				return 0;
+
+			n = size;
+		}
+		else if (TIB_TYPE_COMPLEX != t->type)
+		{
+			return 0;
+		}
+	}
+
+	return n;
+}
+
+static void
+fuse_number(struct fuse_operand *operand, gsl_complex z)
+{
+	operand->data = NULL;
+	operand->number = z;
+	operand->real = (0 == GSL_IMAG(z));
+}
+
+/* widens a chunk of real numbers to complex; dest may be the source */
+static const double *
+fuse_promote(double *dest, const struct fuse_operand *operand, size_t n)
+{
+	if (!operand->data)
+		return operand->number.dat;
+
+	if (!operand->real)
+		return operand->data;
+
+	for (size_t j = n; j-- > 0;)
+	{
+		double x = operand->data[j];
+
+		dest[2 * j] = x;
+		dest[2 * j + 1] = 0;
+	}
+
+	return dest;
+}
+
+/* Runs one operator of a fused run over a chunk of n elements, leaving
+ * the result in a. Returns false where the operator would fail. */
+static bool
+fuse_binary(int c, struct fuse_operand *a, const struct fuse_operand *b,
+	double *dest, double *scratch, size_t n)
+{
+	enum tib_kernel_op op = kernel_op(c);
+	size_t a_step, b_step;
+
+	if (!a->data && !b->data)
+	{
+		gsl_complex z;
+
+		if (tib_token(c)->scalar.tt(&z, a->number, b->number))
+			return false;
+
+		fuse_number(a, z);
+		return true;
+	}
+
+	if (a->real && b->real)
+	{
+		const double *x = a->data ? a->data : a->number.dat;
+		const double *y = b->data ? b->data : b->number.dat;
+
+		a_step = a->data ? 1 : 0;
+		b_step = b->data ? 1 : 0;
+
+		if (TIB_KERNEL_DIV == op
+			&& tib_kernel_real_anyzero(y, b_step ? n : 1))
+			return false;
+
+		tib_kernel_real_binary(op, dest, x, a_step, y, b_step, n);
+	}
+	else
+	{
+		const double *x = fuse_promote(dest, a, n);
+		const double *y = fuse_promote(scratch, b, n);
+
+		a_step = a->data ? 2 : 0;
+		b_step = b->data ? 2 : 0;
+
+		if (TIB_KERNEL_DIV == op
+			&& tib_kernel_anyzero(y, b_step ? n : 1))
+			return false;
+
+		tib_kernel_binary(op, dest, x, a_step, y, b_step, n);
+	}
+
+	a->data = dest;
+	a->real = a->real && b->real;
+	return true;
+}
+
+/* Computes elements [beg, beg + n) of a fused run into out, and sets
+ * *real to whether the result is real-only. With out NULL and n 0,
+ * this only works out *real. Returns false if an operator would fail. */
+static bool
+fuse_chunk(const struct tib_op *ops, int len, TIB **leaves,
+	double *out, size_t beg, size_t n, bool *real)
+{
+	double scratch[FUSE_DEPTH][2 * FUSE_CHUNK];
+	struct fuse_operand stack[FUSE_DEPTH];
+	int sp = 0;
+
+	for (int i = 0; i < len; ++i)
+	{
+		const struct tib_op *op = &ops[i];
+		const TIB *t = leaves[i];
+		struct fuse_operand *top = &stack[sp];
+
+		if (TIB_OP_NUM == op->type)
+		{
+			fuse_number(top, op->value.number);
+		}
+		else if (TIB_OP_VAR == op->type)
+		{
+			if (TIB_TYPE_COMPLEX == t->type)
+			{
+				fuse_number(top, t->value.number);
+			}
+			else
+			{
+				top->real = t->real;
+				top->data = t->real
+					? t->value.real_list->data + beg
+					: t->value.list->data + 2 * beg;
+			}
+		}
+		else
+		{
+			sp -= 2;
+			top = &stack[sp];
+
+			double *dest = scratch[sp];
+			if (out && len - 1 == i)
+				dest = out + (*real ? 1 : 2) * beg;
+
+			if (!fuse_binary(op->c, top, &stack[sp + 1], dest,
+						scratch[sp + 1], n))
+				return false;
+		}
+
+		++sp;
+	}
+
+	*real = stack[0].real;
+	return true;
+}
+
+/* Evaluates a run marked by a FUSE op a chunk of elements at a time,
+ * so every element of the result is computed in one pass and no
+ * intermediate list is built. Returns 1 if the run should be evaluated
+ * op by op instead, which also leaves any errors to be reported there. */
+/* Runs over plain numbers are the common case and gain nothing from
+ * fusing, so they are turned away before any variable is fetched. */
+static bool
+fuse_has_list(const struct tib_op *ops, int len)
+{
+	if (!tib_var_any_list())
+		return false;
+
+	for (int i = 0; i < len; ++i)
+		if (TIB_OP_VAR == ops[i].type && (TIB_CHAR_LUSER == ops[i].c
+				|| TIB_TYPE_LIST == tib_var_type(ops[i].c)))
+			return true;
+
+	return false;
+}
+
+static int
+eval_fused(struct tib_stack *stack, const struct tib_code *code,
+	const struct tib_op *ops, int len)
+{
+	TIB *local_leaves[FUSE_LOCAL_LEN], **leaves = local_leaves;
+	TIB *out = NULL;
+	bool real;
+	int rc = 1;
+
+	if (!fuse_has_list(ops, len))
+		return 1;
+
+	if (len > FUSE_LOCAL_LEN)
+	{
+		leaves = malloc(len * sizeof(TIB *));
+		if (!leaves)
+			return TIB_EALLOC;
+	}
+
+	memset(leaves, 0, len * sizeof(TIB *));
+
+	size_t n = fuse_leaves(code, ops, len, leaves);
+	if (0 == n || !fuse_chunk(ops, len, leaves, NULL, 0, 0, &real))
+		goto end;
+
+	out = real ? tib_new_real_list(NULL, n) : tib_new_list(NULL, n);
+	if (NULL == out)
+	{
+		rc = TIB_EALLOC;
+		goto end;
+	}
+
+	double *data = real ? out->value.real_list->data
+		: out->value.list->data;
+
+	for (size_t beg = 0; beg < n; beg += FUSE_CHUNK)
+	{
+		size_t m = (n - beg < FUSE_CHUNK) ? n - beg : FUSE_CHUNK;
+
+		if (!fuse_chunk(ops, len, leaves, data, beg, m, &real))
+			goto end;
+	}
+
+	rc = tib_stack_push(stack, out);
+	if (!rc)
+		out = NULL;
+
+ end:
+	if (out)
+		tib_decref(out);
+
+	for (int i = 0; i < len; ++i)
+		if (leaves[i])
+			tib_decref(leaves[i]);
+
+	if (leaves != local_leaves)
+		free(leaves);
+
+	return rc;
+}
+
+/* a constant changed since the code was folded, so compile it again */
+static int
+eval_refolded(const struct tib_code *code, tib_Value *out)
+{
+	struct tib_code fresh;
+
+	int rc = tib_compile_in(&fresh, &code->src, code->arena);
+	if (rc)
+		return rc;
+
+	rc = tib_code_eval_value(&fresh, out);
+	tib_code_destroy(&fresh);
+
+	return rc;
+}
+
+int
+tib_code_eval_value(const struct tib_code *code, tib_Value *out)
+{
+	if (code->constants_version
+		&& code->constants_version != tib_var_constants_version())
+		return eval_refolded(code, out);
+
+	struct tib_stack stack;
+	int rc = tib_stack_init(&stack);
+	if (rc)
+		return rc;
+
+	tib_errno = 0;
+
+	for (int i = 0; i < code->len && !rc; ++i)
+	{
+		const struct tib_op *op = &code->data[i];
+		const tib_Value *top;
+		TIB scratch, *t;
+
+		switch (op->type)
+		{
+		case TIB_OP_NUM:
+			rc = tib_stack_push_complex(&stack, op->value.number);
+			continue;
+
+		case TIB_OP_STR:
+			t = tib_new_str(op->value.string);
+			break;
+
+		case TIB_OP_VAR:
+			t = var_get(code, op);
+			break;
+
+		case TIB_OP_CALL:
+			rc = eval_call(&stack, op->c, op->value.argc);
+			continue;
+
+		case TIB_OP_UNARY:
+			rc = eval_unary(&stack, op->c);
+			continue;
+
+		case TIB_OP_BINARY:
+			rc = eval_binary(&stack, op->c);
+			continue;
+
+		case TIB_OP_STO:
+			top = tib_stack_ref(&stack, tib_stack_len(&stack) - 1);
+			rc = var_set(code, op, tib_value_view(top, &scratch));
+			continue;
+
+		case TIB_OP_FUSE:
+			rc = eval_fused(&stack, code, op + 1, op->value.len);
+			if (rc > 0)
+				rc = 0;
+			else if (!rc)
+				i += op->value.len;
+
+			continue;
+
+		default:
+			rc = TIB_ESYNTAX;
+			continue;
+		}
+
+		if (!t)
+		{
+			rc = tib_errno ? tib_errno : TIB_ESYNTAX;
+			break;
+		}
+
+		rc = tib_stack_push(&stack, t);
+		if (rc)
+			tib_decref(t);
+	}
+
+	if (!rc)
+	{
+		if (0 == code->len)
+		{
+			out->boxed = tib_empty();
+			if (!out->boxed)
+				rc = TIB_EALLOC;
+		}
+		else if (tib_stack_len(&stack) != 1)
+		{
+			rc = TIB_ESYNTAX;
+		}
+		else
+		{
+			*out = tib_stack_pop(&stack);
+		}
+	}
+
+	tib_stack_destroy(&stack);
+	return rc;
+}
+
+TIB *
+tib_code_eval(const struct tib_code *code)
+{
+	tib_Value v;
+
+	tib_errno = tib_code_eval_value(code, &v);
+	if (tib_errno)
+		return NULL;
+
+	TIB *out = tib_value_box(&v);
+	tib_value_release(&v);
+
+	return out;
+}
+
+/* Scratch memory for tib_eval. Nested evaluations (e.g. from within
+ * function calls) stack on top of the outer one's mark. */
+static THREAD_LOCAL struct tib_arena eval_arena;
+
+TIB *
+tib_eval(const struct tib_expr *expr)
+{
+	struct tib_arena_mark mark = tib_arena_mark(&eval_arena);
+	struct tib_code code;
+	TIB *out = NULL;
+
+	tib_errno = tib_compile_in(&code, expr, &eval_arena);
+	if (!tib_errno)
+		out = tib_code_eval(&code);
+
+	/* the result is boxed outside of the arena */
+	tib_arena_release(&eval_arena, mark);
+	return out;
+}
+
+void
+tib_eval_free()
+{
+	tib_arena_destroy(&eval_arena);
+
+	free(string_scratch);
+	string_scratch = NULL;
+	string_scratch_size = 0;
 }
 
 int
@@ -591,7 +1615,7 @@ dot_count(const struct tib_expr *expr)
 static bool
 is_number_char(int c)
 {
-	return (isdigit(c) || '.' == c || 'i' == c || is_sign_operator(c));
+	return (tib_isdigit(c) || '.' == c || 'i' == c || is_sign_operator(c));
 }
 
 int
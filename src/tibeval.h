@@ -19,10 +19,71 @@
 #define DELWINK_TIB_EVAL_H
 
 #include <stdbool.h>
+#include <stdio.h>
 
+#include "tibarena.h"
 #include "tibexpr.h"
 #include "tibtype.h"
 
+enum tib_op_type
+{
+	TIB_OP_NUM,
+	TIB_OP_STR,
+	TIB_OP_VAR,
+	TIB_OP_CALL,
+	TIB_OP_UNARY,
+	TIB_OP_BINARY,
+	TIB_OP_STO,
+	TIB_OP_FUSE
+};
+
+struct tib_op
+{
+	enum tib_op_type type;
+	int c;
+
+	union
+	{
+		gsl_complex number;
+		char *string;
+		int argc;
+		int len;
+
+		struct
+		{
+			int beg;
+			int len;
+		} name;
+	} value;
+};
+
+/* An expression lowered to postfix operations. A call pops its
+ * arguments, which are compiled ahead of it like any other operands.
+ * src is a private copy of the input, kept so the code can be compiled
+ * again. When arena is set, all of the buffers belong to it.
+ *
+ * Constant subexpressions are folded at compile time. If that included
+ * a constant variable such as pi, constants_version records the
+ * version it was folded against; otherwise it is 0.
+ *
+ * VAR and STO ops on TIB_CHAR_LUSER refer to a user list, whose name
+ * is the span of src given by value.name.
+ *
+ * A FUSE op marks the next len ops as a run of +, -, * and / over
+ * numbers and variables. If the variables hold lists, the run is
+ * computed elementwise in one pass; otherwise the ops run as usual. */
+struct tib_code
+{
+	struct tib_op *data;
+	int len;
+	int bufsize;
+
+	struct tib_expr src;
+	struct tib_arena *arena;
+
+	unsigned long constants_version;
+};
+
 bool
 is_sign_operator(int c);
 
@@ -35,9 +96,32 @@ sign_count(const struct tib_expr *expr);
 bool
 contains_i(const struct tib_expr *expr);
 
+int
+tib_compile(struct tib_code *dest, const struct tib_expr *expr);
+
+int
+tib_compile_in(struct tib_code *dest, const struct tib_expr *expr,
+		struct tib_arena *arena);
+
+void
+tib_code_destroy(struct tib_code *self);
+
+void
+tib_code_dump(const struct tib_code *code, FILE *f);
+
+int
+tib_code_eval_value(const struct tib_code *code, tib_Value *out);
+
+TIB *
+tib_code_eval(const struct tib_code *code);
+
 TIB *
 tib_eval(const struct tib_expr *expr);
 
+/* releases the calling thread's evaluation scratch memory */
+void
+tib_eval_free(void);
+
 int
 tib_eval_surrounded(const struct tib_expr *expr);
 
@@ -22,13 +22,18 @@
 #include "tibexpr.h"
 #include "tibchar.h"
 #include "tibeval.h"
+#include "util.h"
 
 #define BUFFER_BLOCK_SIZE 16
 
+/* fails to compile if a token value does not fit in tib_Char */
+typedef char tib_char_fits[((tib_Char) TIB_LAST_CHAR == TIB_LAST_CHAR)
+			? 1 : -1];
+
 int
 tib_expr_init(struct tib_expr *self)
 {
-	self->data = malloc(BUFFER_BLOCK_SIZE * sizeof(int));
+	self->data = malloc(BUFFER_BLOCK_SIZE * sizeof(tib_Char));
 	if (!self->data)
 		return TIB_EALLOC;
 
@@ -51,6 +56,81 @@ tib_expr_destroy(struct tib_expr *self)
 	}
 }
 
+int
+tib_expr_reserve(struct tib_expr *self, int len)
+{
+	if (len < 0 || len > TIB_EXPR_MAX_LEN)
+		return TIB_EALLOC;
+
+	if (self->bufsize && len <= self->bufsize)
+		return 0;
+
+	/* a view's copy has to hold what it already refers to */
+	if (!self->bufsize && len < self->len)
+		len = self->len;
+
+	int bufsize = self->bufsize ? self->bufsize : BUFFER_BLOCK_SIZE;
+	while (bufsize < len)
+	{
+		if (bufsize > TIB_EXPR_MAX_LEN / 2)
+			bufsize = TIB_EXPR_MAX_LEN;
+		else
+			bufsize *= 2;
+	}
+
+	tib_Char *data;
+	if (self->bufsize)
+	{
+		data = realloc(self->data, bufsize * sizeof(tib_Char));
+	}
+	else
+	{
+		/* a view gets a private copy of what it refers to */
+		data = malloc(bufsize * sizeof(tib_Char));
+		if (data && self->len)
+			memcpy(data, self->data, self->len * sizeof(tib_Char));
+	}
+
+	if (!data)
+		return TIB_EALLOC;
+
+	self->data = data;
+	self->bufsize = bufsize;
+	return 0;
+}
+
+int
+tib_expr_splice(struct tib_expr *self, int beg, int count,
+		const tib_Char *data, int len)
+{
+	if (beg < 0 || count < 0 || len < 0 || beg > self->len - count)
+		return TIB_EINDEX;
+
+	if (len > TIB_EXPR_MAX_LEN - (self->len - count))
+		return TIB_EALLOC;
+
+	int new_len = self->len - count + len;
+	int rc = tib_expr_reserve(self, new_len);
+	if (rc)
+		return rc;
+
+	if (len != count)
+		memmove(self->data + beg + len, self->data + beg + count,
+			(self->len - beg - count) * sizeof(tib_Char));
+
+	if (len)
+		memcpy(self->data + beg, data, len * sizeof(tib_Char));
+
+	self->len = new_len;
+	return 0;
+}
+
+int
+tib_expr_append(struct tib_expr *self, const tib_Char *data, int len)
+{
+	return tib_expr_splice(self, self->len, 0, data, len);
+}
+
 int
 tib_exprcpy(struct tib_expr *dest, const struct tib_expr *src)
 {
@@ -61,72 +141,128 @@ tib_exprcpy(struct tib_expr *dest, const struct tib_expr *src)
 int
 tib_exprcat(struct tib_expr *dest, const struct tib_expr *src)
 {
-	int rc;
+	int rc = tib_expr_append(dest, src->data, src->len);
+	if (rc)
+		tib_expr_destroy(dest);
 
-	if (!dest->bufsize)
-	{
-		rc = tib_expr_init(dest);
-		if (rc)
-			return rc;
-	}
+	return rc;
+}
 
-	int i;
-	tib_expr_foreach(src, i)
+#define TEXT_TABLE_SIZE (TIB_LAST_CHAR + 1)
+#define TEXT_CACHE_SIZE 2
+
+/* the special text of every token for one get_special function */
+struct text_table
+{
+	const char *(*get_special)(int);
+
+	const char *text[TEXT_TABLE_SIZE];
+	unsigned short len[TEXT_TABLE_SIZE];
+};
+
+/* wide tokens can fall outside the table, even below 0 */
+static bool
+in_text_table(int c)
+{
+	return c >= 0 && c < TEXT_TABLE_SIZE;
+}
+
+static THREAD_LOCAL struct text_table text_cache[TEXT_CACHE_SIZE];
+static THREAD_LOCAL int text_cache_next = 0;
+
+static const struct text_table *
+text_table(const char *(*get_special)(int))
+{
+	struct text_table *table;
+
+	for (int i = 0; i < TEXT_CACHE_SIZE; ++i)
+		if (get_special == text_cache[i].get_special)
+			return &text_cache[i];
+
+	table = &text_cache[text_cache_next];
+	text_cache_next = (text_cache_next + 1) % TEXT_CACHE_SIZE;
+
+	for (int c = 0; c < TEXT_TABLE_SIZE; ++c)
 	{
-		rc = tib_expr_push(dest, src->data[i]);
-		if (rc)
-		{
-			tib_expr_destroy(dest);
-			return rc;
-		}
+		table->text[c] = get_special(c);
+		table->len[c] = table->text[c] ? strlen(table->text[c]) : 1;
 	}
 
-	return 0;
+	table->get_special = get_special;
+	return table;
 }
 
-char *
-tib_expr_tostr_f(const struct tib_expr *self, const char *(*get_special)(int))
+int
+tib_expr_tostr_buf(const struct tib_expr *self,
+		const char *(*get_special)(int), char **buf, size_t *bufsize,
+		size_t *len)
 {
 	if (!self->data)
-	{
-		tib_errno = TIB_ENULLPTR;
-		return NULL;
-	}
+		return TIB_ENULLPTR;
+
+	const struct text_table *table = text_table(get_special);
+	size_t size = 1;
+	int i;
 
-	int i, len = 1;
 	tib_expr_foreach(self, i)
 	{
-		const char *special = get_special(self->data[i]);
-		if (special)
-			len += strlen(special);
+		int c = self->data[i];
+		if (in_text_table(c))
+			size += table->len[c];
 		else
-			++len;
+			size += get_special(c) ? strlen(get_special(c)) : 1;
 	}
 
-	char *out = malloc(len * sizeof(char));
-	if (!out)
+	if (!*buf || *bufsize < size)
 	{
-		tib_errno = TIB_EALLOC;
-		return NULL;
+		char *grown = realloc(*buf, size * sizeof(char));
+		if (!grown)
+			return TIB_EALLOC;
+
+		*buf = grown;
+		*bufsize = size;
 	}
 
-	int bump = 0;
+	char *out = *buf;
 	tib_expr_foreach(self, i)
 	{
-		const char *special = get_special(self->data[i]);
+		int c = self->data[i];
+		const char *special = in_text_table(c) ? table->text[c]
+			: get_special(c);
+
 		if (special)
 		{
-			out[i + bump] = '\0';
-			strcat(out, special);
-			bump += strlen(special) - 1;
+			size_t n = in_text_table(c) ? table->len[c]
+				: strlen(special);
+
+			memcpy(out, special, n);
+			out += n;
 		}
 		else
 		{
-			out[i + bump] = self->data[i];
+			*out++ = c;
 		}
 	}
 
-	out[i + bump] = '\0';
+	*out = '\0';
+
+	if (len)
+		*len = out - *buf;
+
+	return 0;
+}
+
+char *
+tib_expr_tostr_f(const struct tib_expr *self, const char *(*get_special)(int))
+{
+	char *out = NULL;
+	size_t bufsize = 0;
+
+	tib_errno = tib_expr_tostr_buf(self, get_special, &out, &bufsize,
+				NULL);
+	if (tib_errno)
+		return NULL;
+
 	return out;
 }
 
@@ -189,66 +325,14 @@ tib_expr_parse_complex(const struct tib_expr *self, gsl_complex *out)
 int
 tib_expr_delete(struct tib_expr *self, int i)
 {
-	if (i > self->len)
-		return TIB_EINDEX;
-
-	--self->len;
-
-	for (; i < self->len; ++i)
-		self->data[i] = self->data[i + 1];
-
-	return 0;
+	return tib_expr_splice(self, i, 1, NULL, 0);
 }
 
 int
 tib_expr_insert(struct tib_expr *self, int i, int c)
 {
-	if (i > ++self->len)
-	{
-		--self->len;
-		return TIB_EINDEX;
-	}
-
-	if (!self->bufsize)
-	{
-		struct tib_expr temp = { .bufsize = 0 };
-		--self->len;
-
-		int rc = tib_exprcpy(&temp, self);
-		if (rc)
-			return rc;
-
-		*self = temp;
-		++self->len;
-	}
-	else if (self->len > self->bufsize)
-	{
-		if (16384 == self->bufsize)
-		{
-			return TIB_EALLOC;
-		}
-		else
-		{
-			int *old = self->data;
-			self->bufsize *= 2;
-
-			self->data = realloc(self->data,
-					self->bufsize * sizeof(int));
-			if (!self->data)
-			{
-				self->bufsize /= 2;
-				--self->len;
-				self->data = old;
-				return TIB_EALLOC;
-			}
-		}
-	}
-
-	for (int j = self->len - 1; j > i; --j)
-		self->data[j] = self->data[j - 1];
-
-	self->data[i] = c;
-	return 0;
+	tib_Char token = c;
+	return tib_expr_splice(self, i, 0, &token, 1);
 }
 
 int
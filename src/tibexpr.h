@@ -18,13 +18,30 @@
 #ifndef DELWINK_TIB_TIBEXPR_H
 #define DELWINK_TIB_TIBEXPR_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <gsl/gsl_complex.h>
 
 #define tib_expr_foreach(E,I) for ((I) = 0; (I) < (E)->len; ++(I))
 
+/* A single token. Every token value fits in 16 bits; build with
+ * -DTIB_WIDE_TOKENS to store them as int as older versions did. Code
+ * that walks an expression by index is unaffected either way, but
+ * pointers into data must be tib_Char pointers. */
+#ifdef TIB_WIDE_TOKENS
+typedef int tib_Char;
+#else
+typedef uint16_t tib_Char;
+#endif
+
+/* longest expression any buffer may grow to; override at build time */
+#ifndef TIB_EXPR_MAX_LEN
+# define TIB_EXPR_MAX_LEN (1 << 24)
+#endif
+
 struct tib_expr
 {
-	int *data;
+	tib_Char *data;
 	int len;
 	int bufsize;
 };
@@ -35,12 +52,29 @@ tib_expr_init(struct tib_expr *self);
 void
 tib_expr_destroy(struct tib_expr *self);
 
+int
+tib_expr_reserve(struct tib_expr *self, int len);
+
+/* Replaces count tokens at beg with len tokens from data, which must
+ * not point into self. */
+int
+tib_expr_splice(struct tib_expr *self, int beg, int count,
+		const tib_Char *data, int len);
+
+int
+tib_expr_append(struct tib_expr *self, const tib_Char *data, int len);
+
 int
 tib_exprcpy(struct tib_expr *dest, const struct tib_expr *src);
 
 int
 tib_exprcat(struct tib_expr *dest, const struct tib_expr *src);
 
+int
+tib_expr_tostr_buf(const struct tib_expr *self,
+		const char *(*get_special)(int), char **buf, size_t *bufsize,
+		size_t *len);
+
 char *
 tib_expr_tostr_f(const struct tib_expr *self, const char *(*get_special)(int));
 
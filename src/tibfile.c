@@ -0,0 +1,304 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tiberr.h"
+#include "tibfile.h"
+#include "tibtranscode.h"
+
+/* variable entry header lengths with and without version and flag bytes */
+#define ENTRY_HEADER_SHORT 0x0B
+#define ENTRY_HEADER_LONG 0x0D
+
+#define REAL_SIZE 9
+#define COMPLEX_SIZE (2 * REAL_SIZE)
+
+static unsigned int
+le16(const unsigned char *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static int
+add_var(struct tib_file *self, const struct tib_file_var *var)
+{
+	struct tib_file_var *vars = realloc(self->vars,
+			(self->num_vars + 1) * sizeof(struct tib_file_var));
+	if (!vars)
+		return TIB_EALLOC;
+
+	vars[self->num_vars++] = *var;
+	self->vars = vars;
+	return 0;
+}
+
+static int
+parse(struct tib_file *self)
+{
+	const unsigned char *p = self->map;
+
+	if (self->size < TIB_FILE_DATA_OFFSET + 2
+			|| memcmp(p, TIB_FILE_SIGNATURE, TIB_FILE_SIGNATURE_LEN))
+		return TIB_EBADFILE;
+
+	size_t data_len = le16(p + TIB_FILE_DATA_LEN_OFFSET);
+	if (TIB_FILE_DATA_OFFSET + data_len + 2 > self->size)
+		return TIB_EBADFILE;
+
+	const unsigned char *data = p + TIB_FILE_DATA_OFFSET;
+	const unsigned char *end = data + data_len;
+	unsigned int sum = 0;
+
+	for (const unsigned char *b = data; b < end; ++b)
+		sum += *b;
+
+	if ((sum & 0xFFFF) != le16(end))
+		return TIB_EBADFILE;
+
+	while (data < end)
+	{
+		struct tib_file_var var;
+
+		if (end - data < 4)
+			return TIB_EBADFILE;
+
+		size_t header_len = le16(data);
+		if (header_len != ENTRY_HEADER_SHORT
+				&& header_len != ENTRY_HEADER_LONG)
+			return TIB_EBADFILE;
+
+		/* the header length covers the fields between itself and
+		 * the repeated data length */
+		if ((size_t) (end - data) < 2 + header_len + 2)
+			return TIB_EBADFILE;
+
+		var.len = le16(data + 2);
+		var.type = data[4];
+		var.name = data + 5;
+		var.data = data + 2 + header_len + 2;
+
+		if (var.len > (size_t) (end - var.data)
+				|| le16(var.data - 2) != var.len)
+			return TIB_EBADFILE;
+
+		int rc = add_var(self, &var);
+		if (rc)
+			return rc;
+
+		data = var.data + var.len;
+	}
+
+	return 0;
+}
+
+int
+tib_file_open(struct tib_file *self, const char *path)
+{
+	struct stat st;
+	int rc;
+
+	self->map = NULL;
+	self->size = 0;
+	self->vars = NULL;
+	self->num_vars = 0;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return TIB_EBADFILE;
+
+	if (fstat(fd, &st) || st.st_size <= 0)
+	{
+		close(fd);
+		return TIB_EBADFILE;
+	}
+
+	self->size = st.st_size;
+	self->map = mmap(NULL, self->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (MAP_FAILED == self->map)
+	{
+		self->map = NULL;
+		return TIB_EBADFILE;
+	}
+
+	rc = parse(self);
+	if (rc)
+		tib_file_close(self);
+
+	return rc;
+}
+
+void
+tib_file_close(struct tib_file *self)
+{
+	if (self->map)
+		munmap(self->map, self->size);
+
+	free(self->vars);
+
+	self->map = NULL;
+	self->size = 0;
+	self->vars = NULL;
+	self->num_vars = 0;
+}
+
+int
+tib_file_var_tokens(const struct tib_file_var *var, struct tib_expr *dest)
+{
+	if (var->type != TIB_FILE_PROGRAM && var->type != TIB_FILE_PROT_PROGRAM
+			&& var->type != TIB_FILE_STRING)
+		return TIB_ETYPE;
+
+	if (var->len < 2 || le16(var->data) > var->len - 2)
+		return TIB_EBADFILE;
+
+	return tib_decode_bytes(dest, var->data + 2, le16(var->data));
+}
+
+/* reads a number stored as a sign byte, a biased exponent and fourteen
+ * BCD digits */
+static double
+read_real(const unsigned char *p)
+{
+	double value = 0.0;
+
+	for (int i = 0; i < 7; ++i)
+		value = value * 100 + (p[2 + i] >> 4) * 10 + (p[2 + i] & 0xF);
+
+	value *= pow(10, (int) p[1] - 0x80 - 13);
+	return (p[0] & 0x80) ? -value : value;
+}
+
+static gsl_complex
+read_number(const unsigned char *p, bool complex)
+{
+	gsl_complex z;
+
+	GSL_SET_COMPLEX(&z, read_real(p),
+			complex ? read_real(p + REAL_SIZE) : 0.0);
+	return z;
+}
+
+static TIB *
+read_list(const struct tib_file_var *var, bool complex)
+{
+	size_t elem_size = complex ? COMPLEX_SIZE : REAL_SIZE;
+
+	if (var->len < 2)
+		goto bad;
+
+	size_t len = le16(var->data);
+	if (len * elem_size > var->len - 2)
+		goto bad;
+
+	TIB *out = complex ? tib_new_list(NULL, len)
+		: tib_new_real_list(NULL, len);
+	if (!out)
+		return NULL;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		const unsigned char *p = var->data + 2 + i * elem_size;
+
+		if (complex)
+			gsl_vector_complex_set(out->value.list, i,
+					read_number(p, true));
+		else
+			out->value.real_list->data[i] = read_real(p);
+	}
+
+	return out;
+
+ bad:
+	tib_errno = TIB_EBADFILE;
+	return NULL;
+}
+
+static TIB *
+read_matrix(const struct tib_file_var *var)
+{
+	if (var->len < 2)
+		goto bad;
+
+	size_t w = var->data[0], h = var->data[1];
+	if (w * h * REAL_SIZE > var->len - 2)
+		goto bad;
+
+	TIB *out = tib_new_real_matrix(NULL, w, h);
+	if (!out)
+		return NULL;
+
+	gsl_matrix *m = out->value.real_matrix;
+	const unsigned char *p = var->data + 2;
+	for (size_t i = 0; i < h; ++i)
+	{
+		for (size_t j = 0; j < w; ++j)
+		{
+			m->data[i * m->tda + j] = read_real(p);
+			p += REAL_SIZE;
+		}
+	}
+
+	return out;
+
+ bad:
+	tib_errno = TIB_EBADFILE;
+	return NULL;
+}
+
+TIB *
+tib_file_var_value(const struct tib_file_var *var)
+{
+	switch (var->type)
+	{
+	case TIB_FILE_REAL:
+	case TIB_FILE_COMPLEX:
+	{
+		bool complex = (TIB_FILE_COMPLEX == var->type);
+		if (var->len < (complex ? COMPLEX_SIZE : REAL_SIZE))
+		{
+			tib_errno = TIB_EBADFILE;
+			return NULL;
+		}
+
+		gsl_complex z = read_number(var->data, complex);
+		return tib_new_complex(GSL_REAL(z), GSL_IMAG(z));
+	}
+
+	case TIB_FILE_REAL_LIST:
+		return read_list(var, false);
+
+	case TIB_FILE_COMPLEX_LIST:
+		return read_list(var, true);
+
+	case TIB_FILE_MATRIX:
+		return read_matrix(var);
+
+	default:
+		tib_errno = TIB_ETYPE;
+		return NULL;
+	}
+}
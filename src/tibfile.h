@@ -0,0 +1,82 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_FILE_H
+#define DELWINK_TIB_FILE_H
+
+#include <stddef.h>
+
+#include "tibexpr.h"
+#include "tibtype.h"
+
+/* layout shared by every TI-83 Plus family variable file */
+#define TIB_FILE_SIGNATURE "**TI83F*"
+#define TIB_FILE_SIGNATURE_LEN 8
+#define TIB_FILE_COMMENT_OFFSET 11
+#define TIB_FILE_COMMENT_LEN 42
+#define TIB_FILE_DATA_LEN_OFFSET 53
+#define TIB_FILE_DATA_OFFSET 55
+#define TIB_FILE_NAME_LEN 8
+
+enum tib_file_type
+{
+	TIB_FILE_REAL         = 0x00,
+	TIB_FILE_REAL_LIST    = 0x01,
+	TIB_FILE_MATRIX       = 0x02,
+	TIB_FILE_STRING       = 0x04,
+	TIB_FILE_PROGRAM      = 0x05,
+	TIB_FILE_PROT_PROGRAM = 0x06,
+	TIB_FILE_COMPLEX      = 0x0C,
+	TIB_FILE_COMPLEX_LIST = 0x0D
+};
+
+/* One variable entry of a file. The name and data point into the mapping
+ * and stay valid until the file is closed. */
+struct tib_file_var
+{
+	int type;
+	const unsigned char *name;
+	const unsigned char *data;
+	size_t len;
+};
+
+struct tib_file
+{
+	void *map;
+	size_t size;
+
+	struct tib_file_var *vars;
+	int num_vars;
+};
+
+/* Maps an 8xp, 8xl or 8xm file and checks its header and checksum. No
+ * variable data is copied. */
+int
+tib_file_open(struct tib_file *self, const char *path);
+
+void
+tib_file_close(struct tib_file *self);
+
+/* Decodes the tokens of a program or string entry into dest */
+int
+tib_file_var_tokens(const struct tib_file_var *var, struct tib_expr *dest);
+
+/* Builds a value from a real, complex, list or matrix entry */
+TIB *
+tib_file_var_value(const struct tib_file_var *var);
+
+#endif
@@ -15,7 +15,7 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdarg.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
@@ -25,13 +25,14 @@
 
 #include "tibchar.h"
 #include "tiberr.h"
-#include "tibeval.h"
 #include "tibfunction.h"
+#include "tibkernel.h"
+#include "tibtoken.h"
 
 struct registry_node
 {
 	int key;
-	tib_Function f;
+	const struct tib_function *func;
 };
 
 struct registry
@@ -48,105 +49,124 @@ static struct registry registry = {
 };
 
 static TIB *
-func_paren(const struct tib_expr *expr)
+func_paren(TIB **args, int argc)
 {
-	return tib_eval(expr);
+	(void) argc;
+	return tib_copy(args[0]);
 }
 
-static int
-split_number_args(const struct tib_expr *expr, int num_params, ...)
+/* real-only lists and matrices stay real */
+static TIB *
+map_real(const TIB *t, double (*f)(double))
 {
-	const int *beg, *end;
-	int rc = 0, numpar = 0;
-	va_list ap;
+	const gsl_matrix *m;
+	TIB *out;
 
-	va_start(ap, num_params);
-	for (beg = expr->data, end = beg; end < expr->data + expr->len; ++end)
+	if (TIB_TYPE_LIST == t->type)
 	{
-		if (tib_is_func(*end))
-		{
-			++numpar;
-		}
-		else if (')' == *end)
-		{
-			if (--numpar < 0)
-			{
-				rc = TIB_ESYNTAX;
-				break;
-			}
-		}
-		else if (0 == numpar &&
-			(',' == *end || end + 1 == expr->data + expr->len))
-		{
-			if (num_params-- == 0)
-			{
-				rc = TIB_EARGNUM;
-				break;
-			}
-
-			int start = beg - expr->data, stop = end - expr->data;
-			if (end + 1 == expr->data + expr->len)
-				++stop;
-
-			struct tib_expr arg;
-			tib_subexpr(&arg, expr, start, stop);
-
-			TIB *t = tib_eval(&arg);
-			if (!t)
-			{
-				rc = tib_errno;
-				break;
-			}
-
-			if (tib_type(t) != TIB_TYPE_COMPLEX)
-			{
-				tib_decref(t);
-				tib_errno = TIB_ETYPE;
-				break;
-			}
-
-			gsl_complex *out = va_arg(ap, gsl_complex *);
-			*out = tib_complex_value(t);
-			tib_decref(t);
-
-			beg = end + 1;
-		}
+		out = tib_new_real_list(NULL, t->value.real_list->size);
+		if (out)
+			tib_kernel_real_map(out->value.real_list->data,
+					t->value.real_list->data,
+					t->value.real_list->size, f);
+
+		return out;
 	}
-	va_end(ap);
 
-	return rc;
+	m = t->value.real_matrix;
+	out = tib_new_real_matrix(NULL, m->size2, m->size1);
+	if (!out)
+		return NULL;
+
+	for (size_t i = 0; i < m->size1; ++i)
+		tib_kernel_real_map(out->value.real_matrix->data
+					+ i * out->value.real_matrix->tda,
+				m->data + i * m->tda, m->size2, f);
+
+	return out;
 }
 
+/* applies f to a number or to each element of a list or matrix */
 static TIB *
-single_parameter_function(const struct tib_expr *expr,
-			gsl_complex(*f)(gsl_complex))
+map_function(const TIB *t, const struct tib_map *f)
 {
+	const gsl_matrix_complex *m;
 	gsl_complex z;
+	TIB *out;
 
-	tib_errno = split_number_args(expr, 1, &z);
-	if (tib_errno)
-		return NULL;
+	if (t->real && f->real)
+		return map_real(t, f->real);
+
+	if (t->real)
+	{
+		TIB *temp = tib_promote(t);
+		if (!temp)
+			return NULL;
+
+		out = map_function(temp, f);
+		tib_decref(temp);
+		return out;
+	}
 
-	z = f(z);
-	return tib_new_complex(GSL_REAL(z), GSL_IMAG(z));
+	switch (tib_type(t))
+	{
+	case TIB_TYPE_COMPLEX:
+		z = tib_complex_value(t);
+		tib_kernel_map(z.dat, z.dat, 1, f);
+		return tib_new_complex(GSL_REAL(z), GSL_IMAG(z));
+
+	case TIB_TYPE_LIST:
+		out = tib_new_list(NULL, t->value.list->size);
+		if (out)
+			tib_kernel_map(out->value.list->data,
+				t->value.list->data, t->value.list->size, f);
+
+		return out;
+
+	case TIB_TYPE_MATRIX:
+		m = t->value.matrix;
+		out = tib_new_matrix(NULL, m->size2, m->size1);
+		if (!out)
+			return NULL;
+
+		for (size_t i = 0; i < m->size1; ++i)
+			tib_kernel_map(out->value.matrix->data
+					+ 2 * i * out->value.matrix->tda,
+				m->data + 2 * i * m->tda, m->size2, f);
+
+		return out;
+
+	default:
+		tib_errno = TIB_ETYPE;
+		return NULL;
+	}
 }
 
 static TIB *
-func_sin(const struct tib_expr *expr)
+func_sin(TIB **args, int argc)
 {
-	return single_parameter_function(expr, gsl_complex_sin);
+	static const struct tib_map f = { gsl_complex_sin, sin };
+
+	(void) argc;
+	return map_function(args[0], &f);
 }
 
 static TIB *
-func_cos(const struct tib_expr *expr)
+func_cos(TIB **args, int argc)
 {
-	return single_parameter_function(expr, gsl_complex_cos);
+	static const struct tib_map f = { gsl_complex_cos, cos };
+
+	(void) argc;
+	return map_function(args[0], &f);
 }
 
 static TIB *
-func_tan(const struct tib_expr *expr)
+func_tan(TIB **args, int argc)
 {
-	return single_parameter_function(expr, gsl_complex_tan);
+	static const struct tib_map f = { gsl_complex_tan, tan };
+
+	(void) argc;
+	return map_function(args[0], &f);
 }
 
 static int
@@ -156,53 +176,67 @@ is_int(gsl_complex z)
 }
 
 static TIB *
-func_randint(const struct tib_expr *expr)
+func_randint(TIB **args, int argc)
 {
-	int len = expr->len, num_commas = 0;
+	(void) argc;
 
-	for (int i = 0; i < len; ++i)
-	{
-		if (',' == expr->data[i])
-		{
-			if (++num_commas > 2)
-				break;
-		}
-	}
+	gsl_complex min = tib_complex_value(args[0]);
+	gsl_complex max = tib_complex_value(args[1]);
+	gsl_complex count = tib_complex_value(args[2]);
 
-	if (num_commas != 2)
+	if (!(is_int(min) && is_int(max) && is_int(count))
+		|| GSL_REAL(count) < 1 || GSL_REAL(count) > INT_MAX)
 	{
-		tib_errno = TIB_EARGNUM;
+		tib_errno = TIB_EDOMAIN;
 		return NULL;
 	}
 
-	gsl_complex min, max, count;
-	tib_errno = split_number_args(expr, 3, &min, &max, &count);
-	if (tib_errno)
-		return NULL;
-
-	if (!(is_int(min) && is_int(max) && is_int(count))
-		|| GSL_REAL(count) < 0)
-		return NULL;
-
 	double diff = GSL_REAL(max) - GSL_REAL(min);
+	size_t len = GSL_REAL(count);
 
-	len = (unsigned int) GSL_REAL(count);
-	gsl_complex vals[len];
+	TIB *out = tib_new_real_list(NULL, len);
+	if (NULL == out)
+		return NULL;
 
-	for (int i = 0; i < len; ++i)
+	double *vals = out->value.real_list->data;
+	for (size_t i = 0; i < len; ++i)
 	{
-		GSL_SET_COMPLEX(&vals[i], (double) gsl_rng_get(rng), 0);
+		vals[i] = (double) gsl_rng_get(rng);
 
-		while (GSL_REAL(vals[i]) < GSL_REAL(min))
-			GSL_SET_REAL(&vals[i], GSL_REAL(vals[i]) + diff);
+		while (vals[i] < GSL_REAL(min))
+			vals[i] += diff;
 
-		while (GSL_REAL(vals[i]) > GSL_REAL(max))
-			GSL_SET_REAL(&vals[i], GSL_REAL(vals[i]) - diff);
+		while (vals[i] > GSL_REAL(max))
+			vals[i] -= diff;
 	}
 
-	return tib_new_list(vals, len);
+	return out;
 }
 
+#define NUMBER TIB_ARG(TIB_TYPE_COMPLEX)
+
+static const struct tib_function paren = {
+	func_paren, 1, 1, { TIB_ARG_ANY }
+};
+
+static const struct tib_function sin_func = {
+	func_sin, 1, 1, { TIB_ARG_NUMERIC }
+};
+
+static const struct tib_function cos_func = {
+	func_cos, 1, 1, { TIB_ARG_NUMERIC }
+};
+
+static const struct tib_function tan_func = {
+	func_tan, 1, 1, { TIB_ARG_NUMERIC }
+};
+
+static const struct tib_function randint = {
+	func_randint, 3, 3, { NUMBER, NUMBER, NUMBER }
+};
+
+#undef NUMBER
+
 int
 tib_registry_init()
 {
@@ -219,11 +253,11 @@ tib_registry_init()
 
 #define ADD(K,F) rc = tib_registry_add(K, F); if (rc) goto fail;
 
-	ADD('(', func_paren);
-	ADD(TIB_CHAR_SIN, func_sin);
-	ADD(TIB_CHAR_COS, func_cos);
-	ADD(TIB_CHAR_TAN, func_tan);
-	ADD(TIB_CHAR_RANDINT, func_randint);
+	ADD('(', &paren);
+	ADD(TIB_CHAR_SIN, &sin_func);
+	ADD(TIB_CHAR_COS, &cos_func);
+	ADD(TIB_CHAR_TAN, &tan_func);
+	ADD(TIB_CHAR_RANDINT, &randint);
 
 #undef ADD
 
@@ -237,6 +271,9 @@ tib_registry_init()
 void
 tib_registry_free()
 {
+	for (size_t i = 0; i < registry.len; ++i)
+		tib_token_set_func(registry.nodes[i].key, NULL);
+
 	if (registry.nodes)
 		free(registry.nodes);
 	if (rng)
@@ -248,8 +285,16 @@ tib_registry_free()
 }
 
 int
-tib_registry_add(int key, tib_Function f)
+tib_registry_add(int key, const struct tib_function *func)
 {
+	if (func->min_args < 0 || func->max_args > TIB_MAX_ARGS
+		|| func->min_args > func->max_args)
+		return TIB_EARGNUM;
+
+	int rc = tib_token_set_func(key, func);
+	if (rc)
+		return rc;
+
 	struct registry_node *old = registry.nodes;
 
 	++registry.len;
@@ -257,6 +302,7 @@ tib_registry_add(int key, tib_Function f)
 				registry.len * sizeof(struct registry_node));
 	if (NULL == registry.nodes)
 	{
+		tib_token_set_func(key, NULL);
 		registry.nodes = old;
 		--registry.len;
 		return TIB_EALLOC;
@@ -264,7 +310,7 @@ tib_registry_add(int key, tib_Function f)
 
 	struct registry_node new = {
 		.key = key,
-		.f = f
+		.func = func
 	};
 
 	registry.nodes[registry.len - 1] = new;
@@ -274,22 +320,39 @@ tib_registry_add(int key, tib_Function f)
 bool
 tib_is_func(int key)
 {
-	size_t i;
-	for (i = 0; i < registry.len; ++i)
-		if (key == registry.nodes[i].key)
-			return true;
+	return tib_token(key)->func != NULL;
+}
 
-	return false;
+const struct tib_function *
+tib_function(int key)
+{
+	return tib_token(key)->func;
 }
 
 TIB *
-tib_call(int key, const struct tib_expr *expr)
+tib_call(int key, TIB **args, int argc)
 {
-	size_t i;
-	for (i = 0; i < registry.len; ++i)
-		if (key == registry.nodes[i].key)
-			return registry.nodes[i].f(expr);
+	const struct tib_function *func = tib_token(key)->func;
+	if (!func)
+	{
+		tib_errno = TIB_EBADFUNC;
+		return NULL;
+	}
+
+	if (argc < func->min_args || argc > func->max_args)
+	{
+		tib_errno = TIB_EARGNUM;
+		return NULL;
+	}
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (!(func->params[i] & TIB_ARG(tib_type(args[i]))))
+		{
+			tib_errno = TIB_ETYPE;
+			return NULL;
+		}
+	}
 
-	tib_errno = TIB_EBADFUNC;
-	return NULL;
+	return func->f(args, argc);
 }
@@ -20,10 +20,31 @@
 
 #include <stdbool.h>
 
-#include "tibexpr.h"
 #include "tibtype.h"
 
-typedef TIB *(*tib_Function)(const struct tib_expr *);
+#define TIB_MAX_ARGS 4
+
+/* parameter type masks */
+#define TIB_ARG(T) (1u << (T))
+#define TIB_ARG_ANY (~0u)
+#define TIB_ARG_NUMERIC (TIB_ARG(TIB_TYPE_COMPLEX) | TIB_ARG(TIB_TYPE_LIST) \
+			| TIB_ARG(TIB_TYPE_MATRIX))
+
+/* Arguments are evaluated by the caller and checked against the
+ * function's signature. They are only borrowed for the call, and the
+ * result must be a new reference. */
+typedef TIB *(*tib_Function)(TIB **args, int argc);
+
+struct tib_function
+{
+	tib_Function f;
+
+	int min_args;
+	int max_args;
+
+	/* the types each argument may have, as a mask of TIB_ARG bits */
+	unsigned int params[TIB_MAX_ARGS];
+};
 
 int
 tib_registry_init(void);
@@ -32,12 +53,15 @@ void
 tib_registry_free(void);
 
 int
-tib_registry_add(int key, tib_Function f);
+tib_registry_add(int key, const struct tib_function *func);
 
 bool
 tib_is_func(int key);
 
+const struct tib_function *
+tib_function(int key);
+
 TIB *
-tib_call(int key, const struct tib_expr *expr);
+tib_call(int key, TIB **args, int argc);
 
 #endif
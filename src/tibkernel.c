@@ -0,0 +1,442 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tibkernel.h"
+
+/* The x86 kernels are picked at run time, so the library still runs on
+ * processors without AVX2. Every path computes each element with the
+ * same operations in the same order, so the results do not depend on
+ * which one ran. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define TIB_KERNEL_X86
+# include <immintrin.h>
+#endif
+
+bool
+tib_kernel_isreal(const double *in, size_t n)
+{
+	int imaginary = 0;
+
+	/* no early exit, so the loop stays branch free */
+	for (size_t i = 0; i < n; ++i)
+		imaginary |= (0 != in[2 * i + 1]);
+
+	return !imaginary;
+}
+
+static void
+map_real(double *out, const double *in, size_t n, double (*f)(double))
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[2 * i] = f(in[2 * i]);
+		out[2 * i + 1] = 0;
+	}
+}
+
+static void
+map_complex(double *out, const double *in, size_t n,
+	gsl_complex (*f)(gsl_complex))
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		gsl_complex z;
+
+		GSL_SET_COMPLEX(&z, in[2 * i], in[2 * i + 1]);
+		z = f(z);
+
+		out[2 * i] = GSL_REAL(z);
+		out[2 * i + 1] = GSL_IMAG(z);
+	}
+}
+
+void
+tib_kernel_map(double *out, const double *in, size_t n,
+		const struct tib_map *f)
+{
+	if (f->real && tib_kernel_isreal(in, n))
+		map_real(out, in, n, f->real);
+	else
+		map_complex(out, in, n, f->complex);
+}
+
+bool
+tib_kernel_anyzero(const double *in, size_t n)
+{
+	int zero = 0;
+
+	for (size_t i = 0; i < n; ++i)
+		zero |= (0 == in[2 * i] && 0 == in[2 * i + 1]);
+
+	return zero;
+}
+
+static void
+binary_scalar(enum tib_kernel_op op, double *out,
+	const double *a, size_t a_step, const double *b, size_t b_step,
+	size_t i, size_t n)
+{
+	for (; i < n; ++i)
+	{
+		double ar = a[i * a_step], ai = a[i * a_step + 1];
+		double br = b[i * b_step], bi = b[i * b_step + 1];
+		double d;
+
+		switch (op)
+		{
+		case TIB_KERNEL_ADD:
+			out[2 * i] = ar + br;
+			out[2 * i + 1] = ai + bi;
+			break;
+
+		case TIB_KERNEL_SUB:
+			out[2 * i] = ar - br;
+			out[2 * i + 1] = ai - bi;
+			break;
+
+		case TIB_KERNEL_MUL:
+			out[2 * i] = ar * br - ai * bi;
+			out[2 * i + 1] = ai * br + ar * bi;
+			break;
+
+		case TIB_KERNEL_DIV:
+			d = br * br + bi * bi;
+			out[2 * i] = (ar * br + ai * bi) / d;
+			out[2 * i + 1] = (ai * br - ar * bi) / d;
+			break;
+		}
+	}
+}
+
+static void
+real_binary_scalar(enum tib_kernel_op op, double *out,
+		const double *a, size_t a_step,
+		const double *b, size_t b_step, size_t i, size_t n)
+{
+	for (; i < n; ++i)
+	{
+		double x = a[i * a_step], y = b[i * b_step];
+
+		switch (op)
+		{
+		case TIB_KERNEL_ADD:
+			out[i] = x + y;
+			break;
+
+		case TIB_KERNEL_SUB:
+			out[i] = x - y;
+			break;
+
+		case TIB_KERNEL_MUL:
+			out[i] = x * y;
+			break;
+
+		case TIB_KERNEL_DIV:
+			out[i] = x / y;
+			break;
+		}
+	}
+}
+
+#ifdef TIB_KERNEL_X86
+
+/* one complex number per register */
+
+__attribute__((target("sse2")))
+static inline __m128d
+sse2_mul(__m128d a, __m128d b)
+{
+	const __m128d neg_real = _mm_set_pd(0.0, -0.0);
+	__m128d br = _mm_unpacklo_pd(b, b), bi = _mm_unpackhi_pd(b, b);
+	__m128d swapped = _mm_shuffle_pd(a, a, 1);
+
+	return _mm_add_pd(_mm_mul_pd(a, br),
+			_mm_xor_pd(_mm_mul_pd(swapped, bi), neg_real));
+}
+
+__attribute__((target("sse2")))
+static inline __m128d
+sse2_div(__m128d a, __m128d b)
+{
+	const __m128d neg_imag = _mm_set_pd(-0.0, 0.0);
+	__m128d br = _mm_unpacklo_pd(b, b), bi = _mm_unpackhi_pd(b, b);
+	__m128d swapped = _mm_shuffle_pd(a, a, 1);
+	__m128d num = _mm_add_pd(_mm_mul_pd(a, br),
+				_mm_xor_pd(_mm_mul_pd(swapped, bi), neg_imag));
+	__m128d sq = _mm_mul_pd(b, b);
+
+	return _mm_div_pd(num, _mm_add_pd(sq, _mm_shuffle_pd(sq, sq, 1)));
+}
+
+__attribute__((target("sse2")))
+static size_t
+binary_sse2(enum tib_kernel_op op, double *out,
+	const double *a, size_t a_step, const double *b, size_t b_step,
+	size_t n)
+{
+	size_t i = 0;
+
+#define LOOP(F)								\
+	for (; i < n; ++i)						\
+		_mm_storeu_pd(out + 2 * i,				\
+			F(_mm_loadu_pd(a + i * a_step),			\
+				_mm_loadu_pd(b + i * b_step)))
+
+	switch (op)
+	{
+	case TIB_KERNEL_ADD:
+		LOOP(_mm_add_pd);
+		break;
+
+	case TIB_KERNEL_SUB:
+		LOOP(_mm_sub_pd);
+		break;
+
+	case TIB_KERNEL_MUL:
+		LOOP(sse2_mul);
+		break;
+
+	case TIB_KERNEL_DIV:
+		LOOP(sse2_div);
+		break;
+	}
+
+#undef LOOP
+
+	return i;
+}
+
+/* two complex numbers per register */
+
+__attribute__((target("avx2")))
+static inline __m256d
+avx2_load(const double *p, size_t step)
+{
+	if (step)
+		return _mm256_loadu_pd(p);
+
+	return _mm256_broadcast_pd((const __m128d *) p);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d
+avx2_mul(__m256d a, __m256d b)
+{
+	const __m256d neg_real = _mm256_set_pd(0.0, -0.0, 0.0, -0.0);
+	__m256d br = _mm256_movedup_pd(b), bi = _mm256_permute_pd(b, 0xF);
+	__m256d swapped = _mm256_permute_pd(a, 0x5);
+
+	return _mm256_add_pd(_mm256_mul_pd(a, br),
+			_mm256_xor_pd(_mm256_mul_pd(swapped, bi), neg_real));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d
+avx2_div(__m256d a, __m256d b)
+{
+	const __m256d neg_imag = _mm256_set_pd(-0.0, 0.0, -0.0, 0.0);
+	__m256d br = _mm256_movedup_pd(b), bi = _mm256_permute_pd(b, 0xF);
+	__m256d swapped = _mm256_permute_pd(a, 0x5);
+	__m256d num = _mm256_add_pd(_mm256_mul_pd(a, br),
+			_mm256_xor_pd(_mm256_mul_pd(swapped, bi), neg_imag));
+	__m256d sq = _mm256_mul_pd(b, b);
+
+	return _mm256_div_pd(num,
+			_mm256_add_pd(sq, _mm256_permute_pd(sq, 0x5)));
+}
+
+__attribute__((target("avx2")))
+static size_t
+binary_avx2(enum tib_kernel_op op, double *out,
+	const double *a, size_t a_step, const double *b, size_t b_step,
+	size_t n)
+{
+	size_t i = 0;
+
+#define LOOP(F)								\
+	for (; i + 2 <= n; i += 2)					\
+		_mm256_storeu_pd(out + 2 * i,				\
+			F(avx2_load(a + i * a_step, a_step),		\
+				avx2_load(b + i * b_step, b_step)))
+
+	switch (op)
+	{
+	case TIB_KERNEL_ADD:
+		LOOP(_mm256_add_pd);
+		break;
+
+	case TIB_KERNEL_SUB:
+		LOOP(_mm256_sub_pd);
+		break;
+
+	case TIB_KERNEL_MUL:
+		LOOP(avx2_mul);
+		break;
+
+	case TIB_KERNEL_DIV:
+		LOOP(avx2_div);
+		break;
+	}
+
+#undef LOOP
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+real_binary_sse2(enum tib_kernel_op op, double *out,
+		const double *a, size_t a_step,
+		const double *b, size_t b_step, size_t n)
+{
+	__m128d x = _mm_set1_pd(*a), y = _mm_set1_pd(*b);
+	size_t i = 0;
+
+#define LOOP(F)								\
+	for (; i + 2 <= n; i += 2)					\
+	{								\
+		if (a_step)						\
+			x = _mm_loadu_pd(a + i);			\
+		if (b_step)						\
+			y = _mm_loadu_pd(b + i);			\
+		_mm_storeu_pd(out + i, F(x, y));			\
+	}
+
+	switch (op)
+	{
+	case TIB_KERNEL_ADD:
+		LOOP(_mm_add_pd);
+		break;
+
+	case TIB_KERNEL_SUB:
+		LOOP(_mm_sub_pd);
+		break;
+
+	case TIB_KERNEL_MUL:
+		LOOP(_mm_mul_pd);
+		break;
+
+	case TIB_KERNEL_DIV:
+		LOOP(_mm_div_pd);
+		break;
+	}
+
+#undef LOOP
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+real_binary_avx2(enum tib_kernel_op op, double *out,
+		const double *a, size_t a_step,
+		const double *b, size_t b_step, size_t n)
+{
+	__m256d x = _mm256_set1_pd(*a), y = _mm256_set1_pd(*b);
+	size_t i = 0;
+
+#define LOOP(F)								\
+	for (; i + 4 <= n; i += 4)					\
+	{								\
+		if (a_step)						\
+			x = _mm256_loadu_pd(a + i);			\
+		if (b_step)						\
+			y = _mm256_loadu_pd(b + i);			\
+		_mm256_storeu_pd(out + i, F(x, y));			\
+	}
+
+	switch (op)
+	{
+	case TIB_KERNEL_ADD:
+		LOOP(_mm256_add_pd);
+		break;
+
+	case TIB_KERNEL_SUB:
+		LOOP(_mm256_sub_pd);
+		break;
+
+	case TIB_KERNEL_MUL:
+		LOOP(_mm256_mul_pd);
+		break;
+
+	case TIB_KERNEL_DIV:
+		LOOP(_mm256_div_pd);
+		break;
+	}
+
+#undef LOOP
+
+	return i;
+}
+
+#endif
+
+void
+tib_kernel_binary(enum tib_kernel_op op, double *out,
+		const double *a, size_t a_step,
+		const double *b, size_t b_step, size_t n)
+{
+	size_t done = 0;
+
+#ifdef TIB_KERNEL_X86
+	if (__builtin_cpu_supports("avx2"))
+		done = binary_avx2(op, out, a, a_step, b, b_step, n);
+	else if (__builtin_cpu_supports("sse2"))
+		done = binary_sse2(op, out, a, a_step, b, b_step, n);
+#endif
+
+	binary_scalar(op, out, a, a_step, b, b_step, done, n);
+}
+
+bool
+tib_kernel_real_anyzero(const double *in, size_t n)
+{
+	int zero = 0;
+
+	for (size_t i = 0; i < n; ++i)
+		zero |= (0 == in[i]);
+
+	return zero;
+}
+
+void
+tib_kernel_real_map(double *out, const double *in, size_t n,
+		double (*f)(double))
+{
+	for (size_t i = 0; i < n; ++i)
+		out[i] = f(in[i]);
+}
+
+void
+tib_kernel_real_binary(enum tib_kernel_op op, double *out,
+		const double *a, size_t a_step,
+		const double *b, size_t b_step, size_t n)
+{
+	size_t done = 0;
+
+	if (0 == n)
+		return;
+
+#ifdef TIB_KERNEL_X86
+	if (__builtin_cpu_supports("avx2"))
+		done = real_binary_avx2(op, out, a, a_step, b, b_step, n);
+	else if (__builtin_cpu_supports("sse2"))
+		done = real_binary_sse2(op, out, a, a_step, b, b_step, n);
+#endif
+
+	real_binary_scalar(op, out, a, a_step, b, b_step, done, n);
+}
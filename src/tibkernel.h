@@ -0,0 +1,80 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_KERNEL_H
+#define DELWINK_TIB_KERNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <gsl/gsl_complex.h>
+
+/* Kernels run over n complex numbers stored as interleaved (real,
+ * imaginary) pairs, the layout of GSL's complex vectors and of each
+ * matrix row. The output may be the same array as the input. */
+
+enum tib_kernel_op
+{
+	TIB_KERNEL_ADD,
+	TIB_KERNEL_SUB,
+	TIB_KERNEL_MUL,
+	TIB_KERNEL_DIV
+};
+
+struct tib_map
+{
+	gsl_complex (*complex)(gsl_complex);
+
+	/* the same function on the real line, or NULL */
+	double (*real)(double);
+};
+
+bool
+tib_kernel_isreal(const double *in, size_t n);
+
+/* true if any of the numbers is zero, i.e. would divide by zero */
+bool
+tib_kernel_anyzero(const double *in, size_t n);
+
+/* Combines a and b elementwise. Each operand advances by its step in
+ * doubles: 2 to walk an array, or 0 to repeat a single number. Division
+ * by zero is not checked. */
+void
+tib_kernel_binary(enum tib_kernel_op op, double *out,
+		const double *a, size_t a_step,
+		const double *b, size_t b_step, size_t n);
+
+void
+tib_kernel_map(double *out, const double *in, size_t n,
+		const struct tib_map *f);
+
+/* The same for arrays of plain doubles, as held by real-only lists and
+ * matrices. Here an operand steps by 1 to walk an array, or 0 to repeat
+ * a single number. */
+
+bool
+tib_kernel_real_anyzero(const double *in, size_t n);
+
+void
+tib_kernel_real_map(double *out, const double *in, size_t n,
+		double (*f)(double));
+
+void
+tib_kernel_real_binary(enum tib_kernel_op op, double *out,
+		const double *a, size_t a_step,
+		const double *b, size_t b_step, size_t n);
+
+#endif
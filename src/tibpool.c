@@ -0,0 +1,374 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "tiberr.h"
+#include "tibpool.h"
+#include "util.h"
+
+#define TIB_DEPTH 256
+
+union header
+{
+	TIB tib;
+	union header *next;
+};
+
+struct vector_class
+{
+	gsl_vector_complex *free[TIB_POOL_DEPTH];
+	int len;
+};
+
+struct matrix_class
+{
+	gsl_matrix_complex *free[TIB_POOL_DEPTH];
+	int len;
+};
+
+struct real_vector_class
+{
+	gsl_vector *free[TIB_POOL_DEPTH];
+	int len;
+};
+
+struct real_matrix_class
+{
+	gsl_matrix *free[TIB_POOL_DEPTH];
+	int len;
+};
+
+static THREAD_LOCAL union header *headers = NULL;
+static THREAD_LOCAL int headers_len = 0;
+
+static THREAD_LOCAL struct vector_class lists[TIB_POOL_CLASSES];
+static THREAD_LOCAL struct matrix_class matrices[TIB_POOL_CLASSES];
+static THREAD_LOCAL struct real_vector_class real_lists[TIB_POOL_CLASSES];
+static THREAD_LOCAL struct real_matrix_class real_matrices[TIB_POOL_CLASSES];
+
+static THREAD_LOCAL struct tib_pool_stats stats;
+
+static int
+size_class(size_t n)
+{
+	int i;
+
+	for (i = 0; i < TIB_POOL_CLASSES; ++i)
+		if (n <= (size_t) 1 << i)
+			return i;
+
+	return -1;
+}
+
+/* only blocks whose capacity is exactly a class size go back to a pool */
+static int
+exact_class(size_t capacity)
+{
+	int i = size_class(capacity);
+	if (i < 0 || capacity != (size_t) 1 << i)
+		return -1;
+
+	return i;
+}
+
+TIB *
+tib_pool_alloc()
+{
+	union header *out = headers;
+
+	if (out)
+	{
+		headers = out->next;
+		--headers_len;
+		++stats.headers.hits;
+		return &out->tib;
+	}
+
+	++stats.headers.misses;
+	out = malloc(sizeof(union header));
+	if (NULL == out)
+	{
+		tib_errno = TIB_EALLOC;
+		return NULL;
+	}
+
+	return &out->tib;
+}
+
+void
+tib_pool_free(TIB *t)
+{
+	union header *h = (union header *) t;
+
+	if (headers_len >= TIB_DEPTH)
+	{
+		free(h);
+		return;
+	}
+
+	h->next = headers;
+	headers = h;
+	++headers_len;
+}
+
+gsl_vector_complex *
+tib_pool_alloc_list(size_t len)
+{
+	gsl_vector_complex *out;
+	int i = size_class(len);
+
+	if (0 == len || i < 0)
+	{
+		++stats.lists.misses;
+		return gsl_vector_complex_alloc(len);
+	}
+
+	if (lists[i].len)
+	{
+		++stats.lists.hits;
+		out = lists[i].free[--lists[i].len];
+	}
+	else
+	{
+		++stats.lists.misses;
+		out = gsl_vector_complex_alloc((size_t) 1 << i);
+		if (NULL == out)
+			return NULL;
+	}
+
+	out->size = len;
+	return out;
+}
+
+void
+tib_pool_free_list(gsl_vector_complex *v)
+{
+	int i;
+
+	if (NULL == v)
+		return;
+
+	i = exact_class(v->block->size);
+	if (i < 0 || !v->owner || v->stride != 1
+		|| lists[i].len >= TIB_POOL_DEPTH)
+	{
+		gsl_vector_complex_free(v);
+		return;
+	}
+
+	lists[i].free[lists[i].len++] = v;
+}
+
+gsl_matrix_complex *
+tib_pool_alloc_matrix(size_t h, size_t w)
+{
+	gsl_matrix_complex *out;
+	int i;
+
+	if (0 == h || 0 == w || w > TIB_POOL_MAX_ELEMENTS / h)
+	{
+		++stats.matrices.misses;
+		return gsl_matrix_complex_alloc(h, w);
+	}
+
+	i = size_class(h * w);
+	if (matrices[i].len)
+	{
+		++stats.matrices.hits;
+		out = matrices[i].free[--matrices[i].len];
+	}
+	else
+	{
+		++stats.matrices.misses;
+		out = gsl_matrix_complex_alloc((size_t) 1 << i, 1);
+		if (NULL == out)
+			return NULL;
+	}
+
+	out->size1 = h;
+	out->size2 = w;
+	out->tda = w;
+	return out;
+}
+
+void
+tib_pool_free_matrix(gsl_matrix_complex *m)
+{
+	int i;
+
+	if (NULL == m)
+		return;
+
+	i = exact_class(m->block->size);
+	if (i < 0 || !m->owner || m->tda != m->size2
+		|| matrices[i].len >= TIB_POOL_DEPTH)
+	{
+		gsl_matrix_complex_free(m);
+		return;
+	}
+
+	matrices[i].free[matrices[i].len++] = m;
+}
+
+gsl_vector *
+tib_pool_alloc_real_list(size_t len)
+{
+	gsl_vector *out;
+	int i = size_class(len);
+
+	if (0 == len || i < 0)
+	{
+		++stats.lists.misses;
+		return gsl_vector_alloc(len);
+	}
+
+	if (real_lists[i].len)
+	{
+		++stats.lists.hits;
+		out = real_lists[i].free[--real_lists[i].len];
+	}
+	else
+	{
+		++stats.lists.misses;
+		out = gsl_vector_alloc((size_t) 1 << i);
+		if (NULL == out)
+			return NULL;
+	}
+
+	out->size = len;
+	return out;
+}
+
+void
+tib_pool_free_real_list(gsl_vector *v)
+{
+	int i;
+
+	if (NULL == v)
+		return;
+
+	i = exact_class(v->block->size);
+	if (i < 0 || !v->owner || v->stride != 1
+		|| real_lists[i].len >= TIB_POOL_DEPTH)
+	{
+		gsl_vector_free(v);
+		return;
+	}
+
+	real_lists[i].free[real_lists[i].len++] = v;
+}
+
+gsl_matrix *
+tib_pool_alloc_real_matrix(size_t h, size_t w)
+{
+	gsl_matrix *out;
+	int i;
+
+	if (0 == h || 0 == w || w > TIB_POOL_MAX_ELEMENTS / h)
+	{
+		++stats.matrices.misses;
+		return gsl_matrix_alloc(h, w);
+	}
+
+	i = size_class(h * w);
+	if (real_matrices[i].len)
+	{
+		++stats.matrices.hits;
+		out = real_matrices[i].free[--real_matrices[i].len];
+	}
+	else
+	{
+		++stats.matrices.misses;
+		out = gsl_matrix_alloc((size_t) 1 << i, 1);
+		if (NULL == out)
+			return NULL;
+	}
+
+	out->size1 = h;
+	out->size2 = w;
+	out->tda = w;
+	return out;
+}
+
+void
+tib_pool_free_real_matrix(gsl_matrix *m)
+{
+	int i;
+
+	if (NULL == m)
+		return;
+
+	i = exact_class(m->block->size);
+	if (i < 0 || !m->owner || m->tda != m->size2
+		|| real_matrices[i].len >= TIB_POOL_DEPTH)
+	{
+		gsl_matrix_free(m);
+		return;
+	}
+
+	real_matrices[i].free[real_matrices[i].len++] = m;
+}
+
+void
+tib_pool_get_stats(struct tib_pool_stats *out)
+{
+	*out = stats;
+}
+
+double
+tib_pool_hit_rate(const struct tib_pool_count *count)
+{
+	unsigned long total = count->hits + count->misses;
+
+	if (0 == total)
+		return 0.0;
+
+	return (double) count->hits / total;
+}
+
+void
+tib_pool_clear()
+{
+	int i;
+
+	while (headers)
+	{
+		union header *next = headers->next;
+		free(headers);
+		headers = next;
+	}
+	headers_len = 0;
+
+	for (i = 0; i < TIB_POOL_CLASSES; ++i)
+	{
+		while (lists[i].len)
+			gsl_vector_complex_free(lists[i].free[--lists[i].len]);
+
+		while (matrices[i].len)
+			gsl_matrix_complex_free(
+				matrices[i].free[--matrices[i].len]);
+
+		while (real_lists[i].len)
+			gsl_vector_free(
+				real_lists[i].free[--real_lists[i].len]);
+
+		while (real_matrices[i].len)
+			gsl_matrix_free(
+				real_matrices[i].free[--real_matrices[i].len]);
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_POOL_H
+#define DELWINK_TIB_POOL_H
+
+#include <gsl/gsl_matrix_complex_double.h>
+#include <gsl/gsl_matrix_double.h>
+
+#include "tibtype.h"
+
+/* Payloads are rounded up to a power of two. Anything larger than the
+ * biggest class bypasses the pool. */
+#define TIB_POOL_CLASSES 11
+#define TIB_POOL_MAX_ELEMENTS (1 << (TIB_POOL_CLASSES - 1))
+
+/* Upper bound on idle blocks kept per free list */
+#define TIB_POOL_DEPTH 64
+
+struct tib_pool_count
+{
+	unsigned long hits;
+	unsigned long misses;
+};
+
+struct tib_pool_stats
+{
+	struct tib_pool_count headers;
+	struct tib_pool_count lists;
+	struct tib_pool_count matrices;
+};
+
+/* Pools are kept per thread, so none of these need locking. Memory
+ * freed on one thread may be reused by another. */
+
+TIB *
+tib_pool_alloc(void);
+
+void
+tib_pool_free(TIB *t);
+
+gsl_vector_complex *
+tib_pool_alloc_list(size_t len);
+
+void
+tib_pool_free_list(gsl_vector_complex *v);
+
+gsl_matrix_complex *
+tib_pool_alloc_matrix(size_t h, size_t w);
+
+void
+tib_pool_free_matrix(gsl_matrix_complex *m);
+
+/* storage for real-only lists and matrices, counted with the others */
+
+gsl_vector *
+tib_pool_alloc_real_list(size_t len);
+
+void
+tib_pool_free_real_list(gsl_vector *v);
+
+gsl_matrix *
+tib_pool_alloc_real_matrix(size_t h, size_t w);
+
+void
+tib_pool_free_real_matrix(gsl_matrix *m);
+
+void
+tib_pool_get_stats(struct tib_pool_stats *out);
+
+double
+tib_pool_hit_rate(const struct tib_pool_count *count);
+
+/* Returns every idle block held by the calling thread to the system */
+void
+tib_pool_clear(void);
+
+#endif
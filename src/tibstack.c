@@ -0,0 +1,132 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiberr.h"
+#include "tibstack.h"
+
+int
+tib_stack_init(struct tib_stack *self)
+{
+	self->data = self->local;
+	self->bufsize = TIB_STACK_LOCAL_SIZE;
+	self->len = 0;
+
+	return 0;
+}
+
+void
+tib_stack_destroy(struct tib_stack *self)
+{
+	while (self->len)
+		tib_value_release(&self->data[--self->len]);
+
+	if (self->data != self->local)
+		free(self->data);
+
+	self->data = NULL;
+	self->bufsize = 0;
+}
+
+static int
+reserve(struct tib_stack *self)
+{
+	if (self->len < self->bufsize)
+		return 0;
+
+	tib_Value *data;
+	int bufsize = self->bufsize * 2;
+
+	if (self->data == self->local)
+	{
+		data = malloc(bufsize * sizeof(tib_Value));
+		if (data)
+			memcpy(data, self->local, self->len * sizeof(tib_Value));
+	}
+	else
+	{
+		data = realloc(self->data, bufsize * sizeof(tib_Value));
+	}
+
+	if (!data)
+		return TIB_EALLOC;
+
+	self->data = data;
+	self->bufsize = bufsize;
+	return 0;
+}
+
+/* takes over the caller's reference to t; numbers are unboxed */
+int
+tib_stack_push(struct tib_stack *self, TIB *t)
+{
+	if (TIB_TYPE_COMPLEX == tib_type(t))
+	{
+		int rc = tib_stack_push_complex(self, tib_complex_value(t));
+		if (!rc)
+			tib_decref(t);
+
+		return rc;
+	}
+
+	int rc = reserve(self);
+	if (rc)
+		return rc;
+
+	tib_Value *v = &self->data[self->len++];
+	v->boxed = t;
+	GSL_SET_COMPLEX(&v->number, 0, 0);
+
+	return 0;
+}
+
+int
+tib_stack_push_complex(struct tib_stack *self, gsl_complex z)
+{
+	int rc = reserve(self);
+	if (rc)
+		return rc;
+
+	tib_Value *v = &self->data[self->len++];
+	v->boxed = NULL;
+	v->number = z;
+
+	return 0;
+}
+
+/* gives the caller the stack's reference to the value */
+tib_Value
+tib_stack_pop(struct tib_stack *self)
+{
+	const tib_Value none = { .boxed = NULL };
+
+	if (0 == self->len)
+		return none;
+
+	return self->data[--self->len];
+}
+
+const tib_Value *
+tib_stack_ref(const struct tib_stack *self, int index)
+{
+	if (index < 0 || index >= self->len)
+		return NULL;
+
+	return &self->data[index];
+}
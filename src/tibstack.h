@@ -0,0 +1,56 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_STACK_H
+#define DELWINK_TIB_STACK_H
+
+#include "tibtype.h"
+
+#define tib_stack_len(S) ((S)->len)
+
+#define TIB_STACK_LOCAL_SIZE 16
+
+/* Values are kept unboxed where possible. The first few slots live in
+ * the structure itself, so shallow evaluations never allocate. */
+struct tib_stack
+{
+	tib_Value *data;
+	int len;
+	int bufsize;
+
+	tib_Value local[TIB_STACK_LOCAL_SIZE];
+};
+
+int
+tib_stack_init(struct tib_stack *self);
+
+void
+tib_stack_destroy(struct tib_stack *self);
+
+int
+tib_stack_push(struct tib_stack *self, TIB *t);
+
+int
+tib_stack_push_complex(struct tib_stack *self, gsl_complex z);
+
+tib_Value
+tib_stack_pop(struct tib_stack *self);
+
+const tib_Value *
+tib_stack_ref(const struct tib_stack *self, int index);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tiberr.h"
+#include "tibtoken.h"
+
+#define UNARY(F,S,P)						\
+	{ .oper.t = (F), .scalar.t = (S), .arity = 1, .priority = (P) }
+#define BINARY(F,K,S,P)						\
+	{ .oper.tt = (F), .consume = (K), .scalar.tt = (S), .arity = 2,	\
+	  .priority = (P) }
+
+static struct tib_token tokens[TIB_NUM_TOKENS] = {
+	['!']             = UNARY(tib_factorial, tib_complex_factorial, 0),
+	[TIB_CHAR_DEGREE] = UNARY(tib_toradians, tib_complex_toradians, 0),
+	['^']             = BINARY(tib_pow, NULL, tib_complex_pow, 1),
+	['*']             = BINARY(tib_mul, tib_mul_consume,
+				   tib_complex_mul, 2),
+	['/']             = BINARY(tib_div, tib_div_consume,
+				   tib_complex_div, 2),
+	['+']             = BINARY(tib_add, tib_add_consume,
+				   tib_complex_add, 3),
+	['-']             = BINARY(tib_sub, tib_sub_consume,
+				   tib_complex_sub, 3)
+};
+
+#undef UNARY
+#undef BINARY
+
+static const struct tib_token none;
+
+const struct tib_token *
+tib_token(int c)
+{
+	if (c < 0 || c >= TIB_NUM_TOKENS)
+		return &none;
+
+	return &tokens[c];
+}
+
+int
+tib_token_set_func(int c, const struct tib_function *func)
+{
+	if (c < 0 || c >= TIB_NUM_TOKENS)
+		return TIB_EINDEX;
+
+	tokens[c].func = func;
+	return 0;
+}
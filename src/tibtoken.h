@@ -0,0 +1,59 @@
+/*
+ *  libtib - Read, write, and evaluate TI BASIC programs
+ *  Copyright (C) 2017 Delwink, LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published by
+ *  the Free Software Foundation, version 3 only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELWINK_TIB_TOKEN_H
+#define DELWINK_TIB_TOKEN_H
+
+#include "tibchar.h"
+#include "tibfunction.h"
+#include "tibtype.h"
+
+#define TIB_NUM_TOKENS (TIB_LAST_CHAR + 1)
+#define TIB_LAST_PRIORITY 3
+
+struct tib_token
+{
+	union
+	{
+		TIB *(*t)(const TIB *);
+		TIB *(*tt)(const TIB *, const TIB *);
+	} oper;
+
+	/* takes over both operands' references, or NULL */
+	TIB *(*consume)(TIB *, TIB *);
+
+	/* the same operation on an unboxed number, or NULL */
+	union
+	{
+		int (*t)(gsl_complex *, gsl_complex);
+		int (*tt)(gsl_complex *, gsl_complex, gsl_complex);
+	} scalar;
+
+	/* number of operands if this is a math operator, otherwise 0 */
+	int arity;
+	int priority;
+
+	const struct tib_function *func;
+};
+
+const struct tib_token *
+tib_token(int c);
+
+int
+tib_token_set_func(int c, const struct tib_function *func);
+
+#endif
@@ -15,887 +15,368 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdio.h>
 #include <limits.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "tibtranscode.h"
+#include "tibbytes.h"
+#include "tibbytetables.h"
 #include "tibchar.h"
 #include "tiberr.h"
+#include "tibfile.h"
 
-static int
-need_next(int c, int *err, FILE *program, unsigned long *parsed)
-{
-	int next;
+#define TRANSCODE_BLOCK_SIZE 4096
 
-	if ((next = fgetc(program)) == EOF)
-	{
-		*err = TIB_EBADCHAR;
-		return EOF;
-	}
+/* layout of a single-program 8xp file up to the first token */
+#define HEADER_SIZE 72
+#define HEADER_COMMENT "Created by Delwink LiberTI"
+#define ENTRY_HEADER_LEN 0x0B
+#define TOKEN_LEN_OFFSET 70
 
-	++(*parsed);
+/* bytes of the variable entry that are not tokens */
+#define DATA_LEN_EXTRA (HEADER_SIZE - TIB_FILE_DATA_OFFSET)
+#define MAX_TOKEN_BYTES (0xFFFF - DATA_LEN_EXTRA)
 
-	switch (c)
-	{
-	case -69:
-		if (10 == next)
-			return TIB_CHAR_RANDINT;
-
-		*err = TIB_EBADCHAR;
-		return EOF;
-
-	case 92:
-		if (next >= 0 && next <= 8)
-			return next + TIB_CHAR_MATA;
+int
+tib_fread(struct tib_expr *out, FILE *program, unsigned long *parsed)
+{
+	unsigned char block[TRANSCODE_BLOCK_SIZE];
+	unsigned long remaining = ULONG_MAX;
+	int rc, prefix = -1;
+	size_t n;
 
-		*err = TIB_EBADCHAR;
-		return EOF;
+	rc = tib_expr_init(out);
+	if (rc)
+		return rc;
 
-	case 93:
-		if (next >= 0 && next <= 8)
-			return next + TIB_CHAR_L1;
+	*parsed = fread(block, sizeof(char), HEADER_SIZE, program);
+	if (*parsed < HEADER_SIZE - 1)
+	{
+		rc = TIB_EBADFILE;
+		goto end;
+	}
 
-		*err = TIB_EBADCHAR;
-		return EOF;
+	/* files with a real header say how many token bytes follow */
+	if (HEADER_SIZE == *parsed
+			&& !memcmp(block, TIB_FILE_SIGNATURE,
+				TIB_FILE_SIGNATURE_LEN))
+		remaining = block[TOKEN_LEN_OFFSET]
+			| block[TOKEN_LEN_OFFSET + 1] << 8;
+
+	while (remaining && (n = fread(block, sizeof(char),
+				remaining < TRANSCODE_BLOCK_SIZE
+				? remaining : TRANSCODE_BLOCK_SIZE,
+				program)) > 0)
+	{
+		remaining -= n;
 
-	case 96:
-		if (0 == next)
-			return TIB_CHAR_PIC1;
+		/* every byte decodes to at most one token */
+		rc = tib_expr_reserve(out, out->len + n);
+		if (rc)
+			goto end;
 
-		*err = TIB_EBADCHAR;
-		return EOF;
+		tib_Char *dest = out->data + out->len;
+		size_t i = 0;
+		int v;
 
-	case 99:
-		switch (next)
+		if (prefix >= 0)
 		{
-		case 10:
-			return TIB_CHAR_XMIN;
-
-		case 11:
-			return TIB_CHAR_XMAX;
-
-		case 12:
-			return TIB_CHAR_YMIN;
-
-		case 13:
-			return TIB_CHAR_YMAX;
-
-		default:
-			*err = TIB_EBADCHAR;
-			return EOF;
+			v = tib_decode_secondary[prefix][block[i++]];
+			if (TIB_DECODE_UNKNOWN == v)
+			{
+				rc = TIB_EBADCHAR;
+				goto end;
+			}
+
+			*dest++ = v;
+			prefix = -1;
 		}
 
-	case 126:
-		if (9 == c)
-			return TIB_CHAR_AXESOFF;
-
-		*err = TIB_EBADCHAR;
-		return EOF;
+		for (; i < n; ++i)
+		{
+			v = tib_decode_primary[block[i]];
+
+			if (v > 0)
+			{
+				*dest++ = v;
+			}
+			else if (v <= TIB_DECODE_PREFIX(0))
+			{
+				if (i + 1 == n)
+				{
+					prefix = TIB_DECODE_PREFIX_INDEX(v);
+					break;
+				}
+
+				v = tib_decode_secondary[TIB_DECODE_PREFIX_INDEX(v)]
+					[block[++i]];
+				if (TIB_DECODE_UNKNOWN == v)
+				{
+					rc = TIB_EBADCHAR;
+					break;
+				}
+
+				*dest++ = v;
+			}
+			else if (TIB_DECODE_UNKNOWN == v)
+			{
+				/* an unknown byte ends the program unless it is
+				 * the very last one in the file */
+				if (i + 1 == n && remaining
+						&& EOF == fgetc(program))
+					rc = TIB_EBADCHAR;
+
+				out->len = dest - out->data;
+				*parsed += i + 1;
+				goto end;
+			}
+		}
 
-	default:
-		*err = TIB_EBADCHAR;
-		return EOF;
+		out->len = dest - out->data;
+		*parsed += (i < n) ? i + 1 : n;
+		if (rc)
+			goto end;
 	}
-}
-
-static int
-trans_from(int c, int *err, FILE *program, unsigned long *parsed)
-{
-	if (c > SCHAR_MAX)
-		c -= 256;
-
-	/* The original author of LibreCalc's TI emulator had several comments
-	 * in this conversion case analysis where he was unsure of the
-	 * legitimacy of some character converstion. Be wary of the following:
-	 * 91, 109 or 14, 114, 98, 24, 127 or -40, 95
-	 */
-	switch (c)
-	{
-	case -126:
-		return '*';
-
-	case -125:
-		return '/';
-
-	case -123:
-		return TIB_CHAR_CLEARDRAW;
-
-	case -109:
-		return TIB_CHAR_TEXT;
-
-	case -104:
-		return TIB_CHAR_STOREPIC;
-
-	case -103:
-		return TIB_CHAR_RECALLPIC;
-
-	case -100:
-		return TIB_CHAR_LINE;
-
-	case -85:
-		return TIB_CHAR_RAND;
 
-	case -84:
-		return TIB_CHAR_PI;
-
-	case -83:
-		return TIB_CHAR_GETKEY;
-
-	case -81:
-		return '?';
-
-	case -80:
-		return TIB_CHAR_SMALL_MINUS;
-
-	case -79:
-		return TIB_CHAR_INT;
-
-	case -75:
-		return TIB_CHAR_DIM;
-
-	case -72:
-		return TIB_CHAR_NOT;
-
-	case -69:
-		return need_next(c, err, program, parsed);
-
-	case -50:
-		return TIB_CHAR_IF;
-
-	case -49:
-		return TIB_CHAR_THEN;
-
-	case -48:
-		return TIB_CHAR_ELSE;
-
-	case -47:
-		return TIB_CHAR_WHILE;
-
-	case -46:
-		return TIB_CHAR_REPEAT;
-
-	case -45:
-		return TIB_CHAR_FOR;
-
-	case -44:
-		return TIB_CHAR_END;
-
-	case -43:
-		return TIB_CHAR_RETURN;
-
-	case -42:
-		return TIB_CHAR_LABEL;
-
-	case -41:
-		return TIB_CHAR_GOTO;
-
-	case -40:
-		return TIB_CHAR_PAUSE;
-
-	case -39:
-		return TIB_CHAR_STOP;
-
-	case -36:
-		return TIB_CHAR_INPUT;
-
-	case -34:
-		return TIB_CHAR_DISP;
-
-	case -32:
-		return TIB_CHAR_OUTPUT;
-
-	case -31:
-		return TIB_CHAR_CLEARHOME;
-
-	case -30:
-		return TIB_CHAR_FILL;
-
-	case -26:
-		return TIB_CHAR_MENU;
-
-	case -21:
-		return TIB_CHAR_LUSER;
-
-	case -16:
-		return '^';
-
-	case -6:
-		return TIB_CHAR_CLRLIST;
-
-	case 4:
-		return TIB_CHAR_STO;
-
-	case 6:
-		return '[';
-
-	case 7:
-		return ']';
-
-	case 8:
-		return '{';
-
-	case 9:
-		return '}';
-
-	case 11:
-		return TIB_CHAR_DEGREE;
-
-	case 14:
-		return 'T';
-
-	case 16:
-		return '(';
-
-	case 17:
-		return ')';
-
-	case 18:
-		return TIB_CHAR_ROUND;
+	if (ferror(program))
+		rc = TIB_EBADFILE;
+	else if (prefix >= 0)
+		rc = TIB_EBADCHAR;
 
-	case 19:
-		return TIB_CHAR_PIXEL_TEST;
+ end:
+	if (rc)
+		tib_expr_destroy(out);
 
-	case 22:
-		return '|';
+	return rc;
+}
 
-	// 24 was simply skipped in the original emulator; could cause problems
-	case 24:
-		return 0;
+int
+tib_decode_bytes(struct tib_expr *out, const unsigned char *data, size_t len)
+{
+	if (len > (size_t) (TIB_EXPR_MAX_LEN - out->len))
+		return TIB_EALLOC;
 
-	case 41:
-		return ' ';
+	int rc = tib_expr_reserve(out, out->len + len);
+	if (rc)
+		return rc;
 
-	case 42:
-		return '"';
+	const unsigned char *end = data + len;
+	tib_Char *dest = out->data + out->len;
 
-	case 43:
-		return ',';
+	while (data < end)
+	{
+		int v = tib_decode_primary[*data++];
 
-	case 45:
-		return '!';
+		if (v <= TIB_DECODE_PREFIX(0))
+		{
+			if (data == end)
+				return TIB_EBADCHAR;
 
-	case 58:
-		return '.';
+			v = tib_decode_secondary[TIB_DECODE_PREFIX_INDEX(v)]
+				[*data++];
+		}
 
-	case 59:
-		return TIB_CHAR_EPOW10;
+		if (TIB_DECODE_UNKNOWN == v)
+			return TIB_EBADCHAR;
 
-	case 60:
-		return TIB_CHAR_OR;
+		if (v != TIB_DECODE_SKIP)
+			*dest++ = v;
+	}
 
-	case 62:
-	case 63:
-		return '\n';
+	out->len = dest - out->data;
+	return 0;
+}
 
-	case 64:
-		return TIB_CHAR_AND;
+static void
+fill_header(unsigned char *h, const char *name, unsigned long len)
+{
+	unsigned long data_len = len + DATA_LEN_EXTRA;
+	unsigned long var_len = len + 2;
+
+	memset(h, 0, HEADER_SIZE);
+	memcpy(h, TIB_FILE_SIGNATURE, TIB_FILE_SIGNATURE_LEN);
+	h[8] = 0x1A;
+	h[9] = 0x0A;
+	memcpy(h + TIB_FILE_COMMENT_OFFSET, HEADER_COMMENT,
+		strlen(HEADER_COMMENT));
+
+	h[TIB_FILE_DATA_LEN_OFFSET] = data_len & 0xFF;
+	h[TIB_FILE_DATA_LEN_OFFSET + 1] = data_len >> 8;
+
+	unsigned char *entry = h + TIB_FILE_DATA_OFFSET;
+	entry[0] = ENTRY_HEADER_LEN;
+	entry[2] = var_len & 0xFF;
+	entry[3] = var_len >> 8;
+	entry[4] = TIB_FILE_PROGRAM;
+	memcpy(entry + 5, name, TIB_FILE_NAME_LEN);
+	entry[13] = var_len & 0xFF;
+	entry[14] = var_len >> 8;
+
+	h[TOKEN_LEN_OFFSET] = len & 0xFF;
+	h[TOKEN_LEN_OFFSET + 1] = len >> 8;
+}
 
-	case 91:
-		return TIB_CHAR_THETA;
+static int
+flush(struct tib_fwriter *self)
+{
+	size_t n = fwrite(self->buf, sizeof(unsigned char), self->buflen,
+			self->out);
 
-	case 92:
-	case 93:
-		return need_next(c, err, program, parsed);
+	self->written += n;
+	if (n != self->buflen)
+		return TIB_EWRITE;
 
-	// 95 was not evaluated, but it printed "Pause  " to stdout
+	self->buflen = 0;
+	return 0;
+}
 
-	case 96:
-		return need_next(c, err, program, parsed);
+static int
+encoded_len(const struct tib_expr *program, unsigned long *len)
+{
+	int i;
 
-	case 98:
-		return 'c';
+	*len = 0;
+	tib_expr_foreach(program, i)
+	{
+		int c = program->data[i];
+		if (c < 0 || c > TIB_LAST_CHAR || !tib_encode_bytes[c][0])
+			return TIB_EBADCHAR;
 
-	case 99:
-		return need_next(c, err, program, parsed);
+		*len += tib_encode_bytes[c][0];
+	}
 
-	case 106:
-		return '=';
+	return 0;
+}
 
-	case 107:
-		return '<';
+int
+tib_fwriter_init(struct tib_fwriter *self, FILE *out, const char *name,
+		unsigned long len)
+{
+	self->written = 0;
 
-	case 108:
-		return '>';
+	if (!name)
+		name = TIB_DEFAULT_PROGRAM_NAME;
 
-	case 109:
-		return TIB_CHAR_LESSEQUAL;
+	size_t name_len = strlen(name);
+	if (!name_len || name_len > TIB_FILE_NAME_LEN)
+		return TIB_EDOMAIN;
 
-	case 110:
-		return TIB_CHAR_GREATEREQUAL;
+	if (len > MAX_TOKEN_BYTES)
+		return TIB_EOVER;
 
-	case 111:
-		return TIB_CHAR_DIFFERENT;
+	self->out = out;
+	self->start = ftell(out);
+	self->len = 0;
+	self->declared = len;
+	self->checksum = 0;
 
-	case 112:
-		return '+';
+	memset(self->name, 0, TIB_FILE_NAME_LEN);
+	memcpy(self->name, name, name_len);
 
-	case 113:
-		return '-';
+	fill_header(self->buf, self->name, len);
+	self->buflen = HEADER_SIZE;
+	return 0;
+}
 
-	case 114:
-		return TIB_CHAR_ANS;
+int
+tib_fwriter_write(struct tib_fwriter *self, const struct tib_expr *part)
+{
+	int rc, i;
 
-	case 126:
-		return need_next(c, err, program, parsed);
+	tib_expr_foreach(part, i)
+	{
+		int c = part->data[i];
+		/* what is buffered stays there for tib_fwriter_finish */
+		if (c < 0 || c > TIB_LAST_CHAR || !tib_encode_bytes[c][0])
+			return TIB_EBADCHAR;
 
-	case 127:
-		return '[';
+		const unsigned char *bytes = tib_encode_bytes[c];
+		if (self->len + bytes[0] > MAX_TOKEN_BYTES)
+			return TIB_EOVER;
 
-	default:
-		if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z'))
+		if (self->buflen + 2 > TIB_FWRITER_BUFSIZE)
 		{
-			return c;
+			rc = flush(self);
+			if (rc)
+				return rc;
 		}
-		else if (fgetc(program) != EOF || fgetc(program) != EOF)
+
+		self->buf[self->buflen++] = bytes[1];
+		self->checksum += bytes[1];
+
+		if (2 == bytes[0])
 		{
-			*err = 0;
-			*parsed += 2;
-			return EOF;
+			self->buf[self->buflen++] = bytes[2];
+			self->checksum += bytes[2];
 		}
 
-		*err = TIB_EBADCHAR;
-		return EOF;
+		self->len += bytes[0];
 	}
+
+	return 0;
 }
 
 int
-tib_fread(struct tib_expr *out, FILE *program, unsigned long *parsed)
+tib_fwriter_finish(struct tib_fwriter *self)
 {
-	int rc, c;
-
-	rc = tib_expr_init(out);
-	if (rc)
-		return rc;
+	unsigned char h[HEADER_SIZE];
+	int rc;
 
-	*parsed = 0;
-	while ((c = fgetc(program)) != EOF && *parsed < 71)
-		++(*parsed);
+	/* the checksum covers the variable entry, header included */
+	fill_header(h, self->name, self->len);
+	for (int i = TIB_FILE_DATA_OFFSET; i < HEADER_SIZE; ++i)
+		self->checksum += h[i];
 
-	if (*parsed != 71)
+	if (self->buflen + 2 > TIB_FWRITER_BUFSIZE)
 	{
-		rc = TIB_EBADFILE;
-		goto end;
+		rc = flush(self);
+		if (rc)
+			return rc;
 	}
 
-	while ((c = fgetc(program)) != EOF)
+	self->buf[self->buflen++] = self->checksum & 0xFF;
+	self->buf[self->buflen++] = self->checksum >> 8;
+
+	rc = flush(self);
+	if (rc)
+		return rc;
+
+	if (self->len != self->declared)
 	{
-		++(*parsed);
+		if (self->start < 0 || fseek(self->out, self->start, SEEK_SET))
+			return TIB_EWRITE;
 
-		int trans = trans_from((char) c, &rc, program, parsed);
-		if (EOF == trans)
-			break;
+		if (fwrite(h, sizeof(unsigned char), HEADER_SIZE, self->out)
+				!= HEADER_SIZE)
+			return TIB_EWRITE;
 
-		if (trans)
-		{
-			rc = tib_expr_push(out, trans);
-			if (rc)
-				break;
-		}
+		if (fseek(self->out, 0, SEEK_END))
+			return TIB_EWRITE;
 	}
 
- end:
-	if (rc)
-		tib_expr_destroy(out);
-
-	return rc;
+	return fflush(self->out) ? TIB_EWRITE : 0;
 }
 
 int
 tib_fwrite(FILE *out, const struct tib_expr *program, unsigned long *written)
 {
-	int rc, i;
-
-	for (*written = 0; *written <= 71; ++(*written))
-	{
-		rc = fputc(0, out);
-		if (rc)
-			return TIB_EWRITE;
-	}
+	struct tib_fwriter writer;
+	unsigned long len;
 
-	tib_expr_foreach(program, i)
-	{
-		int c = program->data[i];
-		/* The original conversion table had a "TODO transpose"
-		 * comment. May be an incomplete table.
-		 */
-		switch (c)
-		{
-		case '\n':
-			rc = fputc(62, out);
-			break;
-
-		case ' ':
-			rc = fputc(41, out);
-			break;
-
-		case '!':
-			rc = fputc(45, out);
-			break;
-
-		case '"':
-			rc = fputc(42, out);
-			break;
-
-		case '(':
-			rc = fputc(16, out);
-			break;
-
-		case ')':
-			rc = fputc(17, out);
-			break;
-
-		case '*':
-			rc = fputc(-126, out);
-			break;
-
-		case '+':
-			rc = fputc(112, out);
-			break;
-
-		case ',':
-			rc = fputc(43, out);
-			break;
-
-		case '-':
-			rc = fputc(113, out);
-			break;
-
-		case '.':
-			rc = fputc(58, out);
-			break;
-
-		case '/':
-			rc = fputc(-125, out);
-			break;
-
-		case '<':
-			rc = fputc(107, out);
-			break;
-
-		case '=':
-			rc = fputc(106, out);
-			break;
-
-		case '>':
-			rc = fputc(108, out);
-			break;
-
-		case '?':
-			rc = fputc(-81, out);
-			break;
-
-		case '[':
-			rc = fputc(6, out);
-			break;
-
-		case ']':
-			rc = fputc(7, out);
-			break;
-
-		case '^':
-			rc = fputc(-16, out);
-			break;
-
-		case '{':
-			rc = fputc(8, out);
-			break;
-
-		case '|':
-			rc = fputc(22, out);
-			break;
-
-		case '}':
-			rc = fputc(9, out);
-			break;
-
-		case TIB_CHAR_AND:
-			rc = fputc(64, out);
-			break;
-
-		case TIB_CHAR_ANS:
-			rc = fputc(114, out);
-			break;
-
-		case TIB_CHAR_AXESOFF:
-			rc = fputc(126, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(9, out);
-			break;
-
-		case TIB_CHAR_CLEARHOME:
-			rc = fputc(-31, out);
-			break;
-
-		case TIB_CHAR_CLEARDRAW:
-			rc = fputc(-123, out);
-			break;
-
-		case TIB_CHAR_CLRLIST:
-			rc = fputc(-6, out);
-			break;
-
-		case TIB_CHAR_DEGREE:
-			rc = fputc(11, out);
-			break;
-
-		case TIB_CHAR_DIFFERENT:
-			rc = fputc(111, out);
-			break;
-
-		case TIB_CHAR_DIM:
-			rc = fputc(-75, out);
-			break;
-
-		case TIB_CHAR_DISP:
-			rc = fputc(-34, out);
-			break;
-
-		case TIB_CHAR_ELSE:
-			rc = fputc(-48, out);
-			break;
-
-		case TIB_CHAR_END:
-			rc = fputc(-44, out);
-			break;
-
-		case TIB_CHAR_EPOW10:
-			rc = fputc(59, out);
-			break;
-
-		case TIB_CHAR_FILL:
-			rc = fputc(-30, out);
-			break;
-
-		case TIB_CHAR_FOR:
-			rc = fputc(-45, out);
-			break;
-
-		case TIB_CHAR_GETKEY:
-			rc = fputc(-83, out);
-			break;
-
-		case TIB_CHAR_GOTO:
-			rc = fputc(-41, out);
-			break;
-
-		case TIB_CHAR_GREATEREQUAL:
-			rc = fputc(110, out);
-			break;
-
-		case TIB_CHAR_IF:
-			rc = fputc(-50, out);
-			break;
-
-		case TIB_CHAR_INPUT:
-			rc = fputc(-36, out);
-			break;
-
-		case TIB_CHAR_INT:
-			rc = fputc(-79, out);
-			break;
-
-		case TIB_CHAR_L1:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(0, out);
-			break;
-
-		case TIB_CHAR_L2:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(1, out);
-			break;
-
-		case TIB_CHAR_L3:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(2, out);
-			break;
-
-		case TIB_CHAR_L4:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(3, out);
-			break;
-
-		case TIB_CHAR_L5:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(4, out);
-			break;
-
-		case TIB_CHAR_L6:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(5, out);
-			break;
-
-		case TIB_CHAR_L7:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(6, out);
-			break;
-
-		case TIB_CHAR_L8:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(7, out);
-			break;
-
-		case TIB_CHAR_L9:
-			rc = fputc(93, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(8, out);
-			break;
-
-		case TIB_CHAR_LABEL:
-			rc = fputc(-42, out);
-			break;
-
-		case TIB_CHAR_LESSEQUAL:
-			rc = fputc(109, out);
-			break;
-
-		case TIB_CHAR_LINE:
-			rc = fputc(-100, out);
-			break;
-
-		case TIB_CHAR_LUSER:
-			rc = fputc(-21, out);
-			break;
-
-		case TIB_CHAR_MATA:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(0, out);
-			break;
-
-		case TIB_CHAR_MATB:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(1, out);
-			break;
-
-		case TIB_CHAR_MATC:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(2, out);
-			break;
-
-		case TIB_CHAR_MATD:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(3, out);
-			break;
-
-		case TIB_CHAR_MATE:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(4, out);
-			break;
-
-		case TIB_CHAR_MATF:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(5, out);
-			break;
-
-		case TIB_CHAR_MATG:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(6, out);
-			break;
-
-		case TIB_CHAR_MATH:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(7, out);
-			break;
-
-		case TIB_CHAR_MATI:
-			rc = fputc(92, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(8, out);
-			break;
-
-		case TIB_CHAR_MENU:
-			rc = fputc(-26, out);
-			break;
-
-		case TIB_CHAR_NOT:
-			rc = fputc(-72, out);
-			break;
-
-		case TIB_CHAR_OUTPUT:
-			rc = fputc(-32, out);
-			break;
-
-		case TIB_CHAR_OR:
-			rc = fputc(60, out);
-			break;
-
-		case TIB_CHAR_PAUSE:
-			rc = fputc(-40, out);
-			break;
-
-		case TIB_CHAR_PI:
-			rc = fputc(-84, out);
-			break;
-
-		case TIB_CHAR_PIC1:
-			rc = fputc(96, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(0, out);
-			break;
-
-		case TIB_CHAR_PIXEL_TEST:
-			rc = fputc(19, out);
-			break;
-
-		case TIB_CHAR_RAND:
-			rc = fputc(-85, out);
-			break;
-
-		case TIB_CHAR_RANDINT:
-			rc = fputc(-69, out);
-			if (EOF == rc)
-				break;
-			rc = fputc(10, out);
-			break;
-
-		case TIB_CHAR_RECALLPIC:
-			rc = fputc(-103, out);
-			break;
-
-		case TIB_CHAR_REPEAT:
-			rc = fputc(-46, out);
-			break;
-
-		case TIB_CHAR_RETURN:
-			rc = fputc(-43, out);
-			break;
-
-		case TIB_CHAR_ROUND:
-			rc = fputc(18, out);
-			break;
-
-		case TIB_CHAR_SMALL_MINUS:
-			rc = fputc(-80, out);
-			break;
-
-		case TIB_CHAR_STO:
-			rc = fputc(4, out);
-			break;
-
-		case TIB_CHAR_STOP:
-			rc = fputc(-39, out);
-			break;
-
-		case TIB_CHAR_STOREPIC:
-			rc = fputc(-104, out);
-			break;
-
-		case TIB_CHAR_TEXT:
-			rc = fputc(-109, out);
-			break;
-
-		case TIB_CHAR_THEN:
-			rc = fputc(-49, out);
-			break;
-
-		case TIB_CHAR_THETA:
-			rc = fputc(91, out);
-			break;
-
-		case TIB_CHAR_WHILE:
-			rc = fputc(-47, out);
-			break;
-
-		case TIB_CHAR_XMAX:
-			rc = fputc(99, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(11, out);
-			break;
-
-		case TIB_CHAR_XMIN:
-			rc = fputc(99, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(10, out);
-			break;
-
-		case TIB_CHAR_YMAX:
-			rc = fputc(99, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(13, out);
-			break;
-
-		case TIB_CHAR_YMIN:
-			rc = fputc(99, out);
-			if (EOF == rc)
-				break;
-			++(*written);
-			rc = fputc(12, out);
-			break;
-
-		default:
-			if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z'))
-				rc = fputc(c, out);
-			else
-				rc = EOF;
-			break;
-		}
+	*written = 0;
 
-		if (EOF == rc)
-			return TIB_EWRITE;
+	/* knowing the length up front avoids seeking back to the header */
+	int rc = encoded_len(program, &len);
+	if (rc)
+		return rc;
 
-		++(*written);
-	}
+	rc = tib_fwriter_init(&writer, out, NULL, len);
+	if (!rc)
+		rc = tib_fwriter_write(&writer, program);
+	if (!rc)
+		rc = tib_fwriter_finish(&writer);
 
-	return 0;
+	*written = writer.written;
+	return rc;
 }
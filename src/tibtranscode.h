@@ -18,11 +18,45 @@
 #ifndef DELWINK_TIB_TRANSCODE_H
 #define DELWINK_TIB_TRANSCODE_H
 
+#include <stdio.h>
+
 #include "tibexpr.h"
+#include "tibfile.h"
 
 int
 tib_fread(struct tib_expr *out, FILE *program, unsigned long *parsed);
 
+#define TIB_FWRITER_BUFSIZE 4096
+#define TIB_DEFAULT_PROGRAM_NAME "A"
+
+struct tib_fwriter
+{
+	FILE *out;
+	long start;
+	unsigned long written;
+	unsigned long len;
+	unsigned long declared;
+	unsigned short checksum;
+	char name[TIB_FILE_NAME_LEN];
+
+	size_t buflen;
+	unsigned char buf[TIB_FWRITER_BUFSIZE];
+};
+
+int
+tib_fwriter_init(struct tib_fwriter *self, FILE *out, const char *name,
+		unsigned long len);
+
+int
+tib_fwriter_write(struct tib_fwriter *self, const struct tib_expr *part);
+
+int
+tib_fwriter_finish(struct tib_fwriter *self);
+
+/* Appends the tokens stored in len bytes of data to out */
+int
+tib_decode_bytes(struct tib_expr *out, const unsigned char *data, size_t len);
+
 int
 tib_fwrite(FILE *out, const struct tib_expr *program, unsigned long *written);
 
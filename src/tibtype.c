@@ -25,6 +25,8 @@
 
 #include "tibchar.h"
 #include "tiberr.h"
+#include "tibkernel.h"
+#include "tibpool.h"
 #include "tibtype.h"
 #include "tibvar.h"
 #include "util.h"
@@ -32,14 +34,12 @@
 TIB *
 tib_empty()
 {
-	TIB *out = malloc(sizeof(TIB));
+	TIB *out = tib_pool_alloc();
 	if (NULL == out)
-	{
-		tib_errno = TIB_EALLOC;
 		return NULL;
-	}
 
 	out->type = TIB_TYPE_NONE;
+	out->real = false;
 	out->refs = 1;
 
 	return out;
@@ -69,6 +69,18 @@ tib_copy(const TIB *t)
 		return tib_new_str(t->value.string);
 
 	case TIB_TYPE_LIST:
+		if (t->real)
+		{
+			temp = tib_new_real_list(NULL,
+						t->value.real_list->size);
+			if (NULL == temp)
+				return NULL;
+
+			tib_errno = gsl_vector_memcpy(temp->value.real_list,
+						t->value.real_list);
+			break;
+		}
+
 		temp = tib_new_list(NULL, t->value.list->size);
 		if (NULL == temp)
 			return NULL;
@@ -84,8 +96,21 @@ tib_copy(const TIB *t)
 		return temp;
 
 	case TIB_TYPE_MATRIX:
-		temp = tib_new_matrix(NULL, t->value.matrix->size1,
-				t->value.matrix->size2);
+		if (t->real)
+		{
+			temp = tib_new_real_matrix(NULL,
+						t->value.real_matrix->size2,
+						t->value.real_matrix->size1);
+			if (NULL == temp)
+				return NULL;
+
+			tib_errno = gsl_matrix_memcpy(temp->value.real_matrix,
+						t->value.real_matrix);
+			break;
+		}
+
+		temp = tib_new_matrix(NULL, t->value.matrix->size2,
+				t->value.matrix->size1);
 		if (NULL == temp)
 			return NULL;
 
@@ -103,6 +128,14 @@ tib_copy(const TIB *t)
 		tib_errno = TIB_ETYPE;
 		return NULL;
 	}
+
+	if (tib_errno)
+	{
+		tib_decref(temp);
+		return NULL;
+	}
+
+	return temp;
 }
 
 void
@@ -122,11 +155,17 @@ tib_decref(TIB *t)
 		switch (t->type)
 		{
 		case TIB_TYPE_LIST:
-			gsl_vector_complex_free(t->value.list);
+			if (t->real)
+				tib_pool_free_real_list(t->value.real_list);
+			else
+				tib_pool_free_list(t->value.list);
 			break;
 
 		case TIB_TYPE_MATRIX:
-			gsl_matrix_complex_free(t->value.matrix);
+			if (t->real)
+				tib_pool_free_real_matrix(t->value.real_matrix);
+			else
+				tib_pool_free_matrix(t->value.matrix);
 			break;
 
 		case TIB_TYPE_STRING:
@@ -137,21 +176,19 @@ tib_decref(TIB *t)
 			break;
 		}
 
-		free(t);
+		tib_pool_free(t);
 	}
 }
 
 TIB *
 tib_new_complex(double real, double imaginary)
 {
-	TIB *out = malloc(sizeof(TIB));
+	TIB *out = tib_pool_alloc();
 	if (NULL == out)
-	{
-		tib_errno = TIB_EALLOC;
 		return NULL;
-	}
 
 	out->type = TIB_TYPE_COMPLEX;
+	out->real = false;
 	out->refs = 1;
 	GSL_SET_COMPLEX(&out->value.number, real, imaginary);
 
@@ -164,20 +201,18 @@ tib_new_str(const char *value)
 	if (NULL == value)
 		return NULL;
 
-	TIB *out = malloc(sizeof(TIB));
+	TIB *out = tib_pool_alloc();
 	if (NULL == out)
-	{
-		tib_errno = TIB_EALLOC;
 		return NULL;
-	}
 
 	out->type = TIB_TYPE_STRING;
+	out->real = false;
 	out->refs = 1;
 	out->value.string = malloc((strlen(value) + 1) * sizeof(char));
 	if (NULL == out->value.string)
 	{
 		tib_errno = TIB_EALLOC;
-		free(out);
+		tib_pool_free(out);
 		return NULL;
 	}
 
@@ -188,20 +223,18 @@ tib_new_str(const char *value)
 TIB *
 tib_new_list(const gsl_complex *value, size_t len)
 {
-	TIB *out = malloc(sizeof(TIB));
+	TIB *out = tib_pool_alloc();
 	if (NULL == out)
-	{
-		tib_errno = TIB_EALLOC;
 		return NULL;
-	}
 
 	out->type = TIB_TYPE_LIST;
+	out->real = false;
 	out->refs = 1;
-	out->value.list = gsl_vector_complex_alloc(len);
+	out->value.list = tib_pool_alloc_list(len);
 	if (!out->value.list)
 	{
 		tib_errno = TIB_EALLOC;
-		free(out);
+		tib_pool_free(out);
 		return NULL;
 	}
 
@@ -216,20 +249,18 @@ tib_new_list(const gsl_complex *value, size_t len)
 TIB *
 tib_new_matrix(const gsl_complex **value, size_t w, size_t h)
 {
-	TIB *out = malloc(sizeof(TIB));
+	TIB *out = tib_pool_alloc();
 	if (NULL == out)
-	{
-		tib_errno = TIB_EALLOC;
 		return NULL;
-	}
 
 	out->type = TIB_TYPE_MATRIX;
+	out->real = false;
 	out->refs = 1;
-	out->value.matrix = gsl_matrix_complex_alloc(h, w);
+	out->value.matrix = tib_pool_alloc_matrix(h, w);
 	if (!out->value.matrix)
 	{
 		tib_errno = TIB_EALLOC;
-		free(out);
+		tib_pool_free(out);
 		return NULL;
 	}
 
@@ -243,6 +274,108 @@ tib_new_matrix(const gsl_complex **value, size_t w, size_t h)
 	return out;
 }
 
+TIB *
+tib_new_real_list(const double *value, size_t len)
+{
+	TIB *out = tib_pool_alloc();
+	if (NULL == out)
+		return NULL;
+
+	out->type = TIB_TYPE_LIST;
+	out->real = true;
+	out->refs = 1;
+	out->value.real_list = tib_pool_alloc_real_list(len);
+	if (!out->value.real_list)
+	{
+		tib_errno = TIB_EALLOC;
+		tib_pool_free(out);
+		return NULL;
+	}
+
+	if (value != NULL)
+		memcpy(out->value.real_list->data, value,
+			len * sizeof(double));
+
+	return out;
+}
+
+TIB *
+tib_new_real_matrix(const double **value, size_t w, size_t h)
+{
+	TIB *out = tib_pool_alloc();
+	if (NULL == out)
+		return NULL;
+
+	out->type = TIB_TYPE_MATRIX;
+	out->real = true;
+	out->refs = 1;
+	out->value.real_matrix = tib_pool_alloc_real_matrix(h, w);
+	if (!out->value.real_matrix)
+	{
+		tib_errno = TIB_EALLOC;
+		tib_pool_free(out);
+		return NULL;
+	}
+
+	size_t i;
+	if (value != NULL)
+		for (i = 0; i < h; ++i)
+			memcpy(out->value.real_matrix->data
+				+ i * out->value.real_matrix->tda,
+				value[i], w * sizeof(double));
+
+	return out;
+}
+
+static void
+promote_row(double *out, const double *in, size_t n, size_t stride)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[2 * i] = in[i * stride];
+		out[2 * i + 1] = 0;
+	}
+}
+
+TIB *
+tib_promote(const TIB *t)
+{
+	const gsl_matrix *m;
+	TIB *out;
+	size_t i;
+
+	if (!t->real)
+		return tib_copy(t);
+
+	switch (t->type)
+	{
+	case TIB_TYPE_LIST:
+		out = tib_new_list(NULL, t->value.real_list->size);
+		if (out)
+			promote_row(out->value.list->data,
+				t->value.real_list->data,
+				t->value.real_list->size,
+				t->value.real_list->stride);
+
+		return out;
+
+	case TIB_TYPE_MATRIX:
+		m = t->value.real_matrix;
+		out = tib_new_matrix(NULL, m->size2, m->size1);
+		if (out)
+			for (i = 0; i < m->size1; ++i)
+				promote_row(out->value.matrix->data
+						+ 2 * i * out->value.matrix->tda,
+					m->data + i * m->tda, m->size2, 1);
+
+		return out;
+
+	default:
+		tib_errno = TIB_ETYPE;
+		return NULL;
+	}
+}
+
 enum tib_type
 tib_type(const TIB *t)
 {
@@ -272,7 +405,7 @@ tib_str_value(const TIB *t)
 const gsl_vector_complex *
 tib_list_value(const TIB *t)
 {
-	if (t->type == TIB_TYPE_LIST)
+	if (t->type == TIB_TYPE_LIST && !t->real)
 		return t->value.list;
 
 	tib_errno = TIB_ETYPE;
@@ -282,13 +415,45 @@ tib_list_value(const TIB *t)
 const gsl_matrix_complex *
 tib_matrix_value(const TIB *t)
 {
-	if (t->type == TIB_TYPE_MATRIX)
+	if (t->type == TIB_TYPE_MATRIX && !t->real)
 		return t->value.matrix;
 
 	tib_errno = TIB_ETYPE;
 	return NULL;
 }
 
+size_t
+tib_list_size(const TIB *t)
+{
+	if (t->type != TIB_TYPE_LIST)
+	{
+		tib_errno = TIB_ETYPE;
+		return 0;
+	}
+
+	return t->real ? t->value.real_list->size : t->value.list->size;
+}
+
+gsl_complex
+tib_list_get(const TIB *t, size_t i)
+{
+	if (!t->real)
+		return gsl_vector_complex_get(t->value.list, i);
+
+	const gsl_vector *v = t->value.real_list;
+	return (gsl_complex) { .dat = { v->data[i * v->stride], 0 } };
+}
+
+gsl_complex
+tib_matrix_get(const TIB *t, size_t i, size_t j)
+{
+	if (!t->real)
+		return gsl_matrix_complex_get(t->value.matrix, i, j);
+
+	const gsl_matrix *m = t->value.real_matrix;
+	return (gsl_complex) { .dat = { m->data[i * m->tda + j], 0 } };
+}
+
 static void
 format_double_str(char *buf, double value)
 {
@@ -310,8 +475,6 @@ complex_toexpr(struct tib_expr *dest, gsl_complex value)
 	if (abs_too_big(GSL_REAL(value)) || abs_too_big(GSL_IMAG(value)))
 		return TIB_EOVER;
 
-	dest->len = 0;
-
 	if (GSL_REAL(value))
 	{
 		format_double_str(buf, GSL_REAL(value));
@@ -359,7 +522,7 @@ tib_toexpr(struct tib_expr *dest, const TIB *src)
 	if (rc)
 		return rc;
 
-	size_t i;
+	size_t i, rows, cols;
 	switch (src->type)
 	{
 	case TIB_TYPE_NONE:
@@ -379,11 +542,9 @@ tib_toexpr(struct tib_expr *dest, const TIB *src)
 		if (rc)
 			break;
 
-		for (i = 0; i < src->value.list->size; ++i)
+		for (i = 0; i < tib_list_size(src); ++i)
 		{
-			gsl_complex z = gsl_vector_complex_get(src->value.list,
-							i);
-			rc = complex_toexpr(dest, z);
+			rc = complex_toexpr(dest, tib_list_get(src, i));
 			if (rc)
 				goto end;
 
@@ -399,11 +560,16 @@ tib_toexpr(struct tib_expr *dest, const TIB *src)
 		break;
 
 	case TIB_TYPE_MATRIX:
+		rows = src->real ? src->value.real_matrix->size1
+			: src->value.matrix->size1;
+		cols = src->real ? src->value.real_matrix->size2
+			: src->value.matrix->size2;
+
 		rc = tib_expr_push(dest, '[');
 		if (rc)
 			break;
 
-		for (i = 0; i < src->value.matrix->size1; ++i)
+		for (i = 0; i < rows; ++i)
 		{
 			size_t j;
 
@@ -411,12 +577,10 @@ tib_toexpr(struct tib_expr *dest, const TIB *src)
 			if (rc)
 				goto end;
 
-			for (j = 0; j < src->value.matrix->size2; ++j)
+			for (j = 0; j < cols; ++j)
 			{
-				gsl_complex z;
-				z = gsl_matrix_complex_get(src->value.matrix,
-							i, j);
-				rc = complex_toexpr(dest, z);
+				rc = complex_toexpr(dest,
+						tib_matrix_get(src, i, j));
 				if (rc)
 					goto end;
 
@@ -456,184 +620,434 @@ tib_toexpr(struct tib_expr *dest, const TIB *src)
 }
 
 TIB *
-tib_add(const TIB *t1, const TIB *t2)
+tib_value_view(const tib_Value *v, TIB *scratch)
 {
-	if (t1->type != t2->type
-		&& !(TIB_TYPE_COMPLEX == t1->type && TIB_TYPE_LIST == t2->type)
-		&& !(TIB_TYPE_LIST == t1->type && TIB_TYPE_COMPLEX == t2->type))
+	if (v->boxed)
+		return v->boxed;
+
+	scratch->type = TIB_TYPE_COMPLEX;
+	scratch->real = false;
+	scratch->value.number = v->number;
+	scratch->refs = 0;
+
+	return scratch;
+}
+
+TIB *
+tib_value_box(const tib_Value *v)
+{
+	if (v->boxed)
 	{
-		tib_errno = TIB_ETYPE;
-		return NULL;
+		tib_incref(v->boxed);
+		return v->boxed;
 	}
 
-	char *s;
-	TIB *temp;
-	size_t i;
-	switch (t1->type)
+	return tib_new_complex(GSL_REAL(v->number), GSL_IMAG(v->number));
+}
+
+void
+tib_value_release(tib_Value *v)
+{
+	if (v->boxed)
 	{
-	case TIB_TYPE_COMPLEX:
-		if (TIB_TYPE_COMPLEX == t2->type)
-		{
-			temp = tib_copy(t1);
-			if (NULL == temp)
-				return NULL;
+		tib_decref(v->boxed);
+		v->boxed = NULL;
+	}
+}
 
-			temp->value.number = gsl_complex_add(t1->value.number,
-							t2->value.number);
+#define COMPLEX_ONE ((gsl_complex) { .dat = { 1, 0 } })
 
-			return temp;
-		}
-		else
-		{
-			temp = tib_copy(t2);
-			if (NULL == temp)
-				return NULL;
+static bool
+is_zero(gsl_complex z)
+{
+	return 0 == GSL_REAL(z) && 0 == GSL_IMAG(z);
+}
 
-			for (i = 0; i < temp->value.list->size; ++i)
-			{
-				gsl_complex a, sum;
-				a = gsl_vector_complex_get(t2->value.list, i);
-				sum = gsl_complex_add(a, t1->value.number);
-				gsl_vector_complex_set(temp->value.list, i,
-						sum);
-			}
+int
+tib_complex_add(gsl_complex *out, gsl_complex a, gsl_complex b)
+{
+	*out = gsl_complex_add(a, b);
+	return 0;
+}
 
-			return temp;
-		}
+int
+tib_complex_sub(gsl_complex *out, gsl_complex a, gsl_complex b)
+{
+	*out = gsl_complex_sub(a, b);
+	return 0;
+}
 
-	case TIB_TYPE_STRING:
-		s = malloc((strlen(t1->value.string) +
-				strlen(t2->value.string) + 1) * sizeof(char));
-		sprintf(s, "%s%s", t1->value.string, t2->value.string);
-		temp = tib_new_str(s);
-		free(s);
-		return temp;
+int
+tib_complex_mul(gsl_complex *out, gsl_complex a, gsl_complex b)
+{
+	*out = gsl_complex_mul(a, b);
+	return 0;
+}
 
-	case TIB_TYPE_LIST:
-		if (TIB_TYPE_LIST == t2->type)
-		{
-			temp = tib_copy(t1);
-			if (NULL == temp)
-				return NULL;
+int
+tib_complex_div(gsl_complex *out, gsl_complex a, gsl_complex b)
+{
+	if (is_zero(b))
+		return TIB_DBYZERO;
 
-			tib_errno = gsl_vector_complex_add(temp->value.list,
-							t2->value.list);
-			if (tib_errno)
-			{
-				tib_decref(temp);
-				return NULL;
-			}
+	*out = gsl_complex_div(a, b);
+	return 0;
+}
 
-			return temp;
-		}
-		else
-		{
-			return tib_add(t2, t1);
-		}
+int
+tib_complex_pow(gsl_complex *out, gsl_complex z, gsl_complex power)
+{
+	*out = gsl_complex_pow(z, power);
+	return 0;
+}
 
-	case TIB_TYPE_MATRIX:
-		temp = tib_copy(t1);
-		if (NULL == temp)
-			return NULL;
+int
+tib_complex_factorial(gsl_complex *out, gsl_complex z)
+{
+	if (GSL_IMAG(z))
+		return TIB_ETYPE;
 
-		tib_errno = gsl_matrix_complex_add(temp->value.matrix,
-						t2->value.matrix);
-		if (tib_errno)
-		{
-			tib_decref(temp);
-			return NULL;
-		}
+	GSL_SET_COMPLEX(out, gsl_sf_gamma(GSL_REAL(z) + 1), 0);
+	return 0;
+}
 
-		return temp;
+#define RADIANS_PER_DEGREE (3.141592653589793238462643383279502884 / 180)
 
-	default:
-		tib_errno = TIB_ETYPE;
+int
+tib_complex_toradians(gsl_complex *out, gsl_complex z)
+{
+	GSL_SET_COMPLEX(out, GSL_REAL(z) * RADIANS_PER_DEGREE,
+			GSL_IMAG(z) * RADIANS_PER_DEGREE);
+	return 0;
+}
+
+static TIB *
+complex_result(int (*f)(gsl_complex *, gsl_complex, gsl_complex),
+	gsl_complex a, gsl_complex b)
+{
+	gsl_complex z;
+
+	tib_errno = f(&z, a, b);
+	if (tib_errno)
 		return NULL;
-	}
+
+	return tib_new_complex(GSL_REAL(z), GSL_IMAG(z));
 }
 
-TIB *
-tib_sub(const TIB *t1, const TIB *t2)
+/* Returns owned itself if it is t and nobody else holds a reference,
+ * so that it can be overwritten with the result; otherwise a copy. */
+static TIB *
+writable(const TIB *t, TIB *owned)
 {
-	if (t1->type != t2->type
-		&& !(TIB_TYPE_COMPLEX == t1->type && TIB_TYPE_LIST == t2->type)
-		&& !(TIB_TYPE_LIST == t1->type && TIB_TYPE_COMPLEX == t2->type))
+	if (owned == t && 1 == owned->refs)
 	{
-		tib_errno = TIB_ETYPE;
-		return NULL;
+		tib_incref(owned);
+		return owned;
 	}
 
-	TIB *temp;
-	size_t i;
-	switch (t1->type)
+	return tib_copy(t);
+}
+
+/* Like writable for lists, except that a new list is left uninitialized
+ * for the caller to overwrite completely. */
+static TIB *
+list_result(const TIB *t, TIB *owned)
+{
+	if (owned == t && 1 == owned->refs)
 	{
-	case TIB_TYPE_COMPLEX:
-		if (TIB_TYPE_COMPLEX == t2->type)
-		{
-			temp = tib_copy(t1);
-			if (NULL == temp)
-				return NULL;
+		tib_incref(owned);
+		return owned;
+	}
 
-			temp->value.number = gsl_complex_sub(t1->value.number,
-							t2->value.number);
+	return tib_new_list(NULL, t->value.list->size);
+}
 
-			return temp;
-		}
-		else
-		{
-			temp = tib_copy(t2);
-			if (NULL == temp)
-				return NULL;
+static bool
+same_size(const TIB *t1, const TIB *t2)
+{
+	if (t1->value.list->size == t2->value.list->size)
+		return true;
 
-			for (i = 0; i < temp->value.list->size; ++i)
-			{
-				gsl_complex a, diff;
-				a = gsl_vector_complex_get(t2->value.list, i);
-				diff = gsl_complex_sub(a, t1->value.number);
-				gsl_vector_complex_set(temp->value.list, i,
-						diff);
-			}
+	tib_errno = TIB_EDIM;
+	return false;
+}
 
-			return temp;
-		}
+static TIB *
+list_binary(enum tib_kernel_op op, const TIB *t1, const TIB *t2,
+	TIB *own1, TIB *own2)
+{
+	TIB *temp;
 
+	if (TIB_TYPE_LIST != t1->type)
+	{
+		temp = list_result(t2, own2);
+		if (temp)
+			tib_kernel_binary(op, temp->value.list->data,
+					t1->value.number.dat, 0,
+					t2->value.list->data, 2,
+					t2->value.list->size);
+	}
+	else if (TIB_TYPE_LIST != t2->type)
+	{
+		temp = list_result(t1, own1);
+		if (temp)
+			tib_kernel_binary(op, temp->value.list->data,
+					t1->value.list->data, 2,
+					t2->value.number.dat, 0,
+					t1->value.list->size);
+	}
+	else
+	{
+		if (!same_size(t1, t2))
+			return NULL;
+
+		temp = list_result(t1, own1);
+		if (temp)
+			tib_kernel_binary(op, temp->value.list->data,
+					t1->value.list->data, 2,
+					t2->value.list->data, 2,
+					t1->value.list->size);
+	}
+
+	return temp;
+}
+
+static bool
+real_operand(const TIB *t)
+{
+	if (TIB_TYPE_COMPLEX == t->type)
+		return 0 == GSL_IMAG(t->value.number);
+
+	return t->real;
+}
+
+/* Lists combine with lists and numbers; a matrix only scales */
+static bool
+real_pair(enum tib_kernel_op op, const TIB *t1, const TIB *t2)
+{
+	bool list1 = (TIB_TYPE_LIST == t1->type);
+	bool list2 = (TIB_TYPE_LIST == t2->type);
+	bool num1 = (TIB_TYPE_COMPLEX == t1->type);
+	bool num2 = (TIB_TYPE_COMPLEX == t2->type);
+
+	if (!real_operand(t1) || !real_operand(t2))
+		return false;
+
+	if (list1 || list2)
+		return (list1 || num1) && (list2 || num2);
+
+	return TIB_KERNEL_MUL == op && (num1 || num2)
+		&& TIB_TYPE_MATRIX == (num1 ? t2 : t1)->type;
+}
+
+static const double *
+real_data(const TIB *t, size_t *step, size_t *n)
+{
+	switch (t->type)
+	{
 	case TIB_TYPE_LIST:
-		if (TIB_TYPE_LIST == t2->type)
-		{
-			temp = tib_copy(t1);
-			if (NULL == temp)
-				return NULL;
+		*step = 1;
+		*n = t->value.real_list->size;
+		return t->value.real_list->data;
 
-			tib_errno = gsl_vector_complex_sub(temp->value.list,
-							t2->value.list);
-			if (tib_errno)
-			{
-				tib_decref(temp);
-				return NULL;
-			}
+	case TIB_TYPE_MATRIX:
+		*step = 1;
+		*n = t->value.real_matrix->size1 * t->value.real_matrix->size2;
+		return t->value.real_matrix->data;
 
-			return temp;
-		}
+	default:
+		*step = 0;
+		*n = 1;
+		return t->value.number.dat;
+	}
+}
+
+/* a real list or matrix shaped like t, preferably owned itself */
+static TIB *
+real_result(const TIB *t, TIB *owned)
+{
+	if (owned == t && 1 == owned->refs)
+	{
+		tib_incref(owned);
+		return owned;
+	}
+
+	if (TIB_TYPE_LIST == t->type)
+		return tib_new_real_list(NULL, t->value.real_list->size);
+
+	return tib_new_real_matrix(NULL, t->value.real_matrix->size2,
+				t->value.real_matrix->size1);
+}
+
+static TIB *
+real_binary(enum tib_kernel_op op, const TIB *t1, const TIB *t2,
+	TIB *own1, TIB *own2)
+{
+	size_t step1, step2, n1, n2;
+	const double *a = real_data(t1, &step1, &n1);
+	const double *b = real_data(t2, &step2, &n2);
+
+	if (step1 && step2 && n1 != n2)
+	{
+		tib_errno = TIB_EDIM;
+		return NULL;
+	}
+
+	if (TIB_KERNEL_DIV == op && tib_kernel_real_anyzero(b, n2))
+	{
+		tib_errno = TIB_DBYZERO;
+		return NULL;
+	}
+
+	TIB *out = step1 ? real_result(t1, own1) : real_result(t2, own2);
+	if (NULL == out)
+		return NULL;
+
+	double *data = (TIB_TYPE_LIST == out->type)
+		? out->value.real_list->data : out->value.real_matrix->data;
+
+	tib_kernel_real_binary(op, data, a, step1, b, step2,
+			step1 ? n1 : n2);
+	return out;
+}
+
+/* Real-only operands go through the real kernels where they can, and
+ * are promoted for f otherwise. A promoted copy belongs to us, so f is
+ * free to overwrite it. */
+static TIB *
+arith_owned(enum tib_kernel_op op,
+	TIB *(*f)(const TIB *, const TIB *, TIB *, TIB *),
+	const TIB *t1, const TIB *t2, TIB *own1, TIB *own2)
+{
+	TIB *p1 = NULL, *p2 = NULL, *out = NULL;
+
+	if (real_pair(op, t1, t2))
+		return real_binary(op, t1, t2, own1, own2);
+
+	if (t1->real)
+	{
+		p1 = tib_promote(t1);
+		if (NULL == p1)
+			return NULL;
+
+		t1 = own1 = p1;
+	}
+
+	if (t2->real)
+	{
+		p2 = tib_promote(t2);
+		if (NULL == p2)
+			goto end;
+
+		t2 = own2 = p2;
+	}
+
+	out = f(t1, t2, own1, own2);
+
+ end:
+	if (p1)
+		tib_decref(p1);
+	if (p2)
+		tib_decref(p2);
+
+	return out;
+}
+
+static TIB *
+add_complex(const TIB *t1, const TIB *t2, TIB *own1, TIB *own2)
+{
+	if (t1->type != t2->type
+		&& !(TIB_TYPE_COMPLEX == t1->type && TIB_TYPE_LIST == t2->type)
+		&& !(TIB_TYPE_LIST == t1->type && TIB_TYPE_COMPLEX == t2->type))
+	{
+		tib_errno = TIB_ETYPE;
+		return NULL;
+	}
+
+	char *s;
+	TIB *temp;
+	switch (t1->type)
+	{
+	case TIB_TYPE_COMPLEX:
+		if (TIB_TYPE_COMPLEX == t2->type)
+			return complex_result(tib_complex_add, t1->value.number,
+					t2->value.number);
 		else
-		{
-			temp = tib_copy(t2);
-			if (NULL == temp)
-				return NULL;
+			return list_binary(TIB_KERNEL_ADD, t1, t2, own1, own2);
 
-			for (i = 0; i < temp->value.list->size; ++i)
-			{
-				gsl_complex a, diff;
-				a = gsl_vector_complex_get(t2->value.list, i);
-				diff = gsl_complex_sub(t1->value.number, a);
-				gsl_vector_complex_set(temp->value.list, i,
-						diff);
-			}
+	case TIB_TYPE_STRING:
+		s = malloc((strlen(t1->value.string) +
+				strlen(t2->value.string) + 1) * sizeof(char));
+		sprintf(s, "%s%s", t1->value.string, t2->value.string);
+		temp = tib_new_str(s);
+		free(s);
+		return temp;
 
-			return temp;
+	case TIB_TYPE_LIST:
+		return list_binary(TIB_KERNEL_ADD, t1, t2, own1, own2);
+
+	case TIB_TYPE_MATRIX:
+		temp = writable(t1, own1);
+		if (NULL == temp)
+			return NULL;
+
+		tib_errno = gsl_matrix_complex_add(temp->value.matrix,
+						t2->value.matrix);
+		if (tib_errno)
+		{
+			tib_decref(temp);
+			return NULL;
 		}
 
+		return temp;
+
+	default:
+		tib_errno = TIB_ETYPE;
+		return NULL;
+	}
+}
+
+TIB *
+tib_add(const TIB *t1, const TIB *t2)
+{
+	return arith_owned(TIB_KERNEL_ADD, add_complex, t1, t2, NULL, NULL);
+}
+
+TIB *
+tib_add_consume(TIB *t1, TIB *t2)
+{
+	TIB *out = arith_owned(TIB_KERNEL_ADD, add_complex, t1, t2, t1, t2);
+	tib_decref(t1);
+	tib_decref(t2);
+	return out;
+}
+
+static TIB *
+sub_complex(const TIB *t1, const TIB *t2, TIB *own1, TIB *own2)
+{
+	if (t1->type != t2->type
+		&& !(TIB_TYPE_COMPLEX == t1->type && TIB_TYPE_LIST == t2->type)
+		&& !(TIB_TYPE_LIST == t1->type && TIB_TYPE_COMPLEX == t2->type))
+	{
+		tib_errno = TIB_ETYPE;
+		return NULL;
+	}
+
+	TIB *temp;
+	switch (t1->type)
+	{
+	case TIB_TYPE_COMPLEX:
+		if (TIB_TYPE_COMPLEX == t2->type)
+			return complex_result(tib_complex_sub, t1->value.number,
+					t2->value.number);
+		else
+			return list_binary(TIB_KERNEL_SUB, t1, t2, own1, own2);
+
+	case TIB_TYPE_LIST:
+		return list_binary(TIB_KERNEL_SUB, t1, t2, own1, own2);
+
 	case TIB_TYPE_MATRIX:
-		temp = tib_copy(t1);
+		temp = writable(t1, own1);
 		if (NULL == temp)
 			return NULL;
 
@@ -653,6 +1067,21 @@ tib_sub(const TIB *t1, const TIB *t2)
 	}
 }
 
+TIB *
+tib_sub(const TIB *t1, const TIB *t2)
+{
+	return arith_owned(TIB_KERNEL_SUB, sub_complex, t1, t2, NULL, NULL);
+}
+
+TIB *
+tib_sub_consume(TIB *t1, TIB *t2)
+{
+	TIB *out = arith_owned(TIB_KERNEL_SUB, sub_complex, t1, t2, t1, t2);
+	tib_decref(t1);
+	tib_decref(t2);
+	return out;
+}
+
 static int
 matrix_mul(gsl_matrix_complex *out, const gsl_matrix_complex *m1,
 	const gsl_matrix_complex *m2)
@@ -661,8 +1090,8 @@ matrix_mul(gsl_matrix_complex *out, const gsl_matrix_complex *m1,
 	return gsl_blas_zgemm(CblasNoTrans, CblasNoTrans, a, m1, m2, b, out);
 }
 
-TIB *
-tib_mul(const TIB *t1, const TIB *t2)
+static TIB *
+mul_complex(const TIB *t1, const TIB *t2, TIB *own1, TIB *own2)
 {
 	if (t1->type != t2->type)
 	{
@@ -693,89 +1122,39 @@ tib_mul(const TIB *t1, const TIB *t2)
 	}
 
 	TIB *temp;
-	size_t i, j;
+	gsl_matrix_complex *m;
+	size_t i;
 	switch (t1->type)
 	{
 	case TIB_TYPE_COMPLEX:
 		if (TIB_TYPE_COMPLEX == t2->type)
 		{
-			temp = tib_copy(t1);
-			if (NULL == temp)
-				return NULL;
-
-			temp->value.number = gsl_complex_mul(t1->value.number,
-							t2->value.number);
-
-			return temp;
+			return complex_result(tib_complex_mul, t1->value.number,
+					t2->value.number);
 		}
-		else
+		else if (TIB_TYPE_LIST == t2->type)
 		{
-			temp = tib_copy(t2);
-			if (NULL == temp)
-				return NULL;
-
-			gsl_complex a, product;
-			if (TIB_TYPE_LIST == t2->type)
-			{
-				for (i = 0; i < t2->value.list->size; ++i)
-				{
-					a = gsl_vector_complex_get(t2->value.
-								list, i);
-					product =
-					    gsl_complex_mul(t1->value.number,
-							    a);
-					gsl_vector_complex_set(temp->value.list,
-							i, product);
-				}
-			}
-			else // must be matrix
-			{
-				for (i = 0; i < t2->value.matrix->size1; ++i)
-					for (j = 0; j < t2->value.matrix->size2;
-					     ++j)
-					{
-						a = gsl_matrix_complex_get(t2->value.matrix,
-									i, j);
-						product = gsl_complex_mul(t1->value.number,
-									a);
-						gsl_matrix_complex_set(temp->value.matrix,
-								i, j,
-								product);
-					}
-			}
-
-			return temp;
+			return list_binary(TIB_KERNEL_MUL, t1, t2, own1, own2);
 		}
-
-	case TIB_TYPE_LIST:
-		if (TIB_TYPE_LIST == t2->type)
+		else // must be matrix
 		{
-			if (t1->value.list->size != t2->value.list->size)
-			{
-				tib_errno = TIB_EDIM;
-				return NULL;
-			}
-
-			temp = tib_copy(t1);
+			temp = writable(t2, own2);
 			if (NULL == temp)
 				return NULL;
 
-			for (i = 0; i < temp->value.list->size; ++i)
-			{
-				gsl_complex a, b, product;
-				a = gsl_vector_complex_get(t1->value.list, i);
-				b = gsl_vector_complex_get(t2->value.list, i);
-				product = gsl_complex_mul(a, b);
-				gsl_vector_complex_set(temp->value.list, i,
-						product);
-			}
+			m = temp->value.matrix;
+			for (i = 0; i < m->size1; ++i)
+				tib_kernel_binary(TIB_KERNEL_MUL,
+						m->data + 2 * i * m->tda,
+						t1->value.number.dat, 0,
+						m->data + 2 * i * m->tda, 2,
+						m->size2);
 
 			return temp;
 		}
-		else // must be complex
-		{
-			return tib_mul(t2, t1);
-		}
+
+	case TIB_TYPE_LIST:
+		return list_binary(TIB_KERNEL_MUL, t1, t2, own1, own2);
 
 	case TIB_TYPE_MATRIX:
 		if (TIB_TYPE_MATRIX == t2->type)
@@ -803,7 +1182,7 @@ tib_mul(const TIB *t1, const TIB *t2)
 		}
 		else // must be complex
 		{
-			return tib_mul(t2, t1);
+			return mul_complex(t2, t1, own2, own1);
 		}
 
 	default:
@@ -812,14 +1191,27 @@ tib_mul(const TIB *t1, const TIB *t2)
 	}
 }
 
+TIB *
+tib_mul(const TIB *t1, const TIB *t2)
+{
+	return arith_owned(TIB_KERNEL_MUL, mul_complex, t1, t2, NULL, NULL);
+}
+
+TIB *
+tib_mul_consume(TIB *t1, TIB *t2)
+{
+	TIB *out = arith_owned(TIB_KERNEL_MUL, mul_complex, t1, t2, t1, t2);
+	tib_decref(t1);
+	tib_decref(t2);
+	return out;
+}
+
 static bool
 less_than_0(gsl_complex x)
 {
 	return gsl_complex_abs(x) < 0;
 }
 
-#define COMPLEX_ONE ((gsl_complex) { .dat = { 1, 0 } })
-
 static TIB *
 inverse(const TIB *t)
 {
@@ -856,14 +1248,8 @@ inverse(const TIB *t)
 	}
 }
 
-static bool
-is_zero(gsl_complex z)
-{
-	return 0 == GSL_REAL(z) && 0 == GSL_IMAG(z);
-}
-
-TIB *
-tib_div(const TIB *t1, const TIB *t2)
+static TIB *
+div_complex(const TIB *t1, const TIB *t2, TIB *own1, TIB *own2)
 {
 	if (!(TIB_TYPE_COMPLEX == t1->type || TIB_TYPE_LIST == t1->type)
 		|| !(TIB_TYPE_COMPLEX == t2->type || TIB_TYPE_LIST == t2->type))
@@ -872,97 +1258,35 @@ tib_div(const TIB *t1, const TIB *t2)
 		return NULL;
 	}
 
-	TIB *temp;
-	size_t i;
-	switch (t1->type)
-	{
-	case TIB_TYPE_COMPLEX:
-		if (TIB_TYPE_COMPLEX == t2->type)
-		{
-			if (is_zero(t2->value.number))
-			{
-				tib_errno = TIB_DBYZERO;
-				return NULL;
-			}
-
-			temp = tib_copy(t1);
-			if (NULL == temp)
-				return NULL;
+	if (TIB_TYPE_COMPLEX == t1->type && TIB_TYPE_COMPLEX == t2->type)
+		return complex_result(tib_complex_div, t1->value.number,
+				t2->value.number);
 
-			temp->value.number = gsl_complex_div(t1->value.number,
-							t2->value.number);
-		}
-		else // must be list
-		{
-			temp = tib_copy(t2);
-			if (NULL == temp)
-				return NULL;
-
-			for (i = 0; i < temp->value.list->size; ++i)
-			{
-				gsl_complex a, q;
-				a = gsl_vector_complex_get(t2->value.list, i);
-				if (is_zero(a))
-				{
-					tib_decref(temp);
-					tib_errno = TIB_DBYZERO;
-					return NULL;
-				}
-
-				q = gsl_complex_div(t1->value.number, a);
-				gsl_vector_complex_set(temp->value.list, i, q);
-			}
-		}
-
-		return temp;
-
-	case TIB_TYPE_LIST:
-		temp = tib_copy(t1);
-		if (NULL == temp)
-			return NULL;
-
-		if (TIB_TYPE_LIST == t2->type)
-		{
-			for (i = 0; i < temp->value.list->size; ++i)
-			{
-				gsl_complex a, b, q;
-				a = gsl_vector_complex_get(t1->value.list, i);
-				b = gsl_vector_complex_get(t2->value.list, i);
-				if (is_zero(b))
-				{
-					tib_decref(temp);
-					tib_errno = TIB_DBYZERO;
-					return NULL;
-				}
-
-				q = gsl_complex_div(a, b);
-				gsl_vector_complex_set(temp->value.list, i, q);
-			}
-		}
-		else // must be complex
-		{
-			if (is_zero(t2->value.number))
-			{
-				tib_decref(temp);
-				tib_errno = TIB_DBYZERO;
-				return NULL;
-			}
+	if (TIB_TYPE_LIST == t2->type
+		? tib_kernel_anyzero(t2->value.list->data,
+				t2->value.list->size)
+		: is_zero(t2->value.number))
+	{
+		tib_errno = TIB_DBYZERO;
+		return NULL;
+	}
 
-			for (i = 0; i < temp->value.list->size; ++i)
-			{
-				gsl_complex a, q;
-				a = gsl_vector_complex_get(t1->value.list, i);
-				q = gsl_complex_div(a, t2->value.number);
-				gsl_vector_complex_set(temp->value.list, i, q);
-			}
-		}
+	return list_binary(TIB_KERNEL_DIV, t1, t2, own1, own2);
+}
 
-		return temp;
+TIB *
+tib_div(const TIB *t1, const TIB *t2)
+{
+	return arith_owned(TIB_KERNEL_DIV, div_complex, t1, t2, NULL, NULL);
+}
 
-	default:
-		tib_errno = TIB_ETYPE;
-		return NULL;
-	}
+TIB *
+tib_div_consume(TIB *t1, TIB *t2)
+{
+	TIB *out = arith_owned(TIB_KERNEL_DIV, div_complex, t1, t2, t1, t2);
+	tib_decref(t1);
+	tib_decref(t2);
+	return out;
 }
 
 static gsl_complex
@@ -971,8 +1295,8 @@ complex_root(gsl_complex z, gsl_complex root)
 	return gsl_complex_pow(z, gsl_complex_div(COMPLEX_ONE, root));
 }
 
-TIB *
-tib_root(const TIB *t, gsl_complex root)
+static TIB *
+root_complex(const TIB *t, gsl_complex root)
 {
 	TIB *temp;
 	size_t i;
@@ -1009,14 +1333,29 @@ tib_root(const TIB *t, gsl_complex root)
 	}
 }
 
+TIB *
+tib_root(const TIB *t, gsl_complex root)
+{
+	if (!t->real)
+		return root_complex(t, root);
+
+	TIB *temp = tib_promote(t);
+	if (NULL == temp)
+		return NULL;
+
+	TIB *out = root_complex(temp, root);
+	tib_decref(temp);
+	return out;
+}
+
 static bool
 is_int(gsl_complex z)
 {
 	return fmod(GSL_REAL(z), 1.0) == 0 && fmod(GSL_IMAG(z), 1.0) == 0;
 }
 
-TIB *
-tib_pow(const TIB *t, const TIB *power)
+static TIB *
+pow_complex(const TIB *t, const TIB *power)
 {
 	TIB *temp;
 
@@ -1028,6 +1367,9 @@ tib_pow(const TIB *t, const TIB *power)
 
 	gsl_complex exp = tib_complex_value(power);
 
+	if (TIB_TYPE_COMPLEX == t->type)
+		return complex_result(tib_complex_pow, t->value.number, exp);
+
 	if (less_than_0(exp))
 	{
 		temp = inverse(t);
@@ -1047,10 +1389,6 @@ tib_pow(const TIB *t, const TIB *power)
 	size_t i;
 	switch (t->type)
 	{
-	case TIB_TYPE_COMPLEX:
-		temp->value.number = gsl_complex_pow(t->value.number, exp);
-		return temp;
-
 	case TIB_TYPE_LIST:
 		for (i = 0; i < t->value.list->size; ++i)
 		{
@@ -1121,28 +1459,47 @@ tib_pow(const TIB *t, const TIB *power)
 	}
 }
 
+TIB *
+tib_pow(const TIB *t, const TIB *power)
+{
+	if (!t->real)
+		return pow_complex(t, power);
+
+	TIB *temp = tib_promote(t);
+	if (NULL == temp)
+		return NULL;
+
+	TIB *out = pow_complex(temp, power);
+	tib_decref(temp);
+	return out;
+}
+
 TIB *
 tib_factorial(const TIB *t)
 {
-	if (t->type != TIB_TYPE_COMPLEX || GSL_IMAG(t->value.number))
+	gsl_complex z;
+
+	if (t->type != TIB_TYPE_COMPLEX)
 	{
 		tib_errno = TIB_ETYPE;
 		return NULL;
 	}
 
-	return tib_new_complex(gsl_sf_gamma(GSL_REAL(t->value.number) + 1), 0);
+	tib_errno = tib_complex_factorial(&z, t->value.number);
+	if (tib_errno)
+		return NULL;
+
+	return tib_new_complex(GSL_REAL(z), GSL_IMAG(z));
 }
 
 TIB *
 tib_toradians(const TIB *t)
 {
-	TIB *factor = tib_new_complex(3.141592653589793238462643383279502884 / 180,
-				0);
-	if (!factor)
-		return NULL;
+	const tib_Value factor = {
+		.boxed = NULL,
+		.number = { .dat = { RADIANS_PER_DEGREE, 0 } }
+	};
+	TIB scratch;
 
-	TIB *temp = tib_mul(t, factor);
-	tib_decref(factor);
-
-	return temp;
+	return tib_mul(t, tib_value_view(&factor, &scratch));
 }
@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <gsl/gsl_matrix_complex_double.h>
+#include <gsl/gsl_matrix_double.h>
 #include <gsl/gsl_complex.h>
 
 #include "tibexpr.h"
@@ -41,15 +42,31 @@ union variant
 	char *string;
 	gsl_vector_complex *list;
 	gsl_matrix_complex *matrix;
+
+	/* storage of real-only lists and matrices */
+	gsl_vector *real_list;
+	gsl_matrix *real_matrix;
 };
 
+/* A list or matrix with no imaginary parts may be stored as doubles,
+ * which is flagged by real. Operations without a real version work on
+ * a promoted copy. */
 typedef struct
 {
 	enum tib_type type;
+	bool real;
 	union variant value;
 	size_t refs;
 } TIB;
 
+/* Either a reference to a TIB or, when boxed is NULL, a complex number
+ * held inline. Inline numbers never touch the heap. */
+typedef struct
+{
+	TIB *boxed;
+	gsl_complex number;
+} tib_Value;
+
 TIB *
 tib_empty(void);
 
@@ -74,6 +91,16 @@ tib_new_list(const gsl_complex *value, size_t len);
 TIB *
 tib_new_matrix(const gsl_complex **value, size_t w, size_t h);
 
+TIB *
+tib_new_real_list(const double *value, size_t len);
+
+TIB *
+tib_new_real_matrix(const double **value, size_t w, size_t h);
+
+/* returns a copy of a list or matrix with complex storage */
+TIB *
+tib_promote(const TIB *t);
+
 enum tib_type
 tib_type(const TIB *t);
 
@@ -83,27 +110,82 @@ tib_complex_value(const TIB *t);
 const char *
 tib_str_value(const TIB *t);
 
+/* these fail with TIB_ETYPE on real-only storage; see tib_promote */
 const gsl_vector_complex *
 tib_list_value(const TIB *t);
 
 const gsl_matrix_complex *
 tib_matrix_value(const TIB *t);
 
+size_t
+tib_list_size(const TIB *t);
+
+gsl_complex
+tib_list_get(const TIB *t, size_t i);
+
+gsl_complex
+tib_matrix_get(const TIB *t, size_t i, size_t j);
+
 int
 tib_toexpr(struct tib_expr *dest, const TIB *src);
 
+TIB *
+tib_value_view(const tib_Value *v, TIB *scratch);
+
+TIB *
+tib_value_box(const tib_Value *v);
+
+void
+tib_value_release(tib_Value *v);
+
+int
+tib_complex_add(gsl_complex *out, gsl_complex a, gsl_complex b);
+
+int
+tib_complex_sub(gsl_complex *out, gsl_complex a, gsl_complex b);
+
+int
+tib_complex_mul(gsl_complex *out, gsl_complex a, gsl_complex b);
+
+int
+tib_complex_div(gsl_complex *out, gsl_complex a, gsl_complex b);
+
+int
+tib_complex_pow(gsl_complex *out, gsl_complex z, gsl_complex power);
+
+int
+tib_complex_factorial(gsl_complex *out, gsl_complex z);
+
+int
+tib_complex_toradians(gsl_complex *out, gsl_complex z);
+
 TIB *
 tib_add(const TIB *t1, const TIB *t2);
 
+/* Like tib_add, but takes over the caller's references to the operands
+ * and writes the result into one of them if it is not shared. The
+ * other _consume functions behave the same way. */
+TIB *
+tib_add_consume(TIB *t1, TIB *t2);
+
 TIB *
 tib_sub(const TIB *t1, const TIB *t2);
 
+TIB *
+tib_sub_consume(TIB *t1, TIB *t2);
+
 TIB *
 tib_mul(const TIB *t1, const TIB *t2);
 
+TIB *
+tib_mul_consume(TIB *t1, TIB *t2);
+
 TIB *
 tib_div(const TIB *t1, const TIB *t2);
 
+TIB *
+tib_div_consume(TIB *t1, TIB *t2);
+
 TIB *
 tib_pow(const TIB *t, const TIB *power);
 
@@ -20,17 +20,34 @@
 
 #include "tibchar.h"
 #include "tiberr.h"
+#include "tibtoken.h"
 #include "tibvar.h"
 
-struct varlist
+#define LIST_NAME_BASE 38
+#define LIST_TABLE_MIN 16
+
+/* every built-in variable is named by a single token */
+static TIB *vars[TIB_NUM_TOKENS];
+
+/* how many of them hold lists */
+static int num_list_vars = 0;
+
+/* bumped whenever a constant changes, so folded copies can be
+ * detected; never 0 */
+static unsigned long constants_version = 1;
+
+/* user lists, open addressed by packed name; key 0 marks a free slot */
+struct list_table
 {
-	tib_Variable *vars;
+	tib_Variable *slots;
 	int len;
+	int bufsize;
 };
 
-static struct varlist varlist = {
+static struct list_table lists = {
+	.slots = NULL,
 	.len = 0,
-	.vars = NULL
+	.bufsize = 0
 };
 
 int
@@ -69,82 +86,251 @@ tib_var_init()
 void
 tib_var_free()
 {
-	for (int i = 0; i < varlist.len; ++i)
-		tib_decref(varlist.vars[i].value);
+	++constants_version;
 
-	free(varlist.vars);
+	for (int i = 0; i < TIB_NUM_TOKENS; ++i)
+	{
+		if (vars[i])
+		{
+			tib_decref(vars[i]);
+			vars[i] = NULL;
+		}
+	}
+
+	num_list_vars = 0;
+
+	for (int i = 0; i < lists.bufsize; ++i)
+		if (lists.slots[i].key)
+			tib_decref(lists.slots[i].value);
 
-	varlist.len = 0;
-	varlist.vars = NULL;
+	free(lists.slots);
+
+	lists.slots = NULL;
+	lists.len = 0;
+	lists.bufsize = 0;
 }
 
-static int
-add_var(int key, const TIB *value)
+/* Values are shared rather than copied. Nothing may modify a TIB that
+ * has more than one reference, so a shared value is effectively
+ * copied on write. Values that are not refcounted (refs == 0) do not
+ * outlive their owner and have to be copied. */
+static TIB *
+share(TIB *value)
 {
-	tib_Variable *old = varlist.vars;
+	if (0 == value->refs)
+		return tib_copy(value);
 
-	++varlist.len;
-	varlist.vars = realloc(varlist.vars,
-			varlist.len * sizeof(tib_Variable));
-	if (NULL == varlist.vars)
-	{
-		varlist.vars = old;
-		--varlist.len;
-		return TIB_EALLOC;
-	}
-
-	tib_errno = 0;
-	tib_Variable *new = varlist.vars + varlist.len - 1;
-	new->key = key;
-	new->value = tib_copy(value);
-	if (tib_errno)
-		--varlist.len;
+	tib_incref(value);
+	return value;
+}
 
-	return tib_errno;
+static bool
+is_var_key(int key)
+{
+	return key >= 0 && key < TIB_NUM_TOKENS;
 }
 
 int
-tib_var_set(int key, const TIB *value)
+tib_var_set(int key, TIB *value)
 {
-	if (!tib_is_var(key))
-		return add_var(key, value);
+	if (!is_var_key(key))
+		return TIB_EINDEX;
+
+	TIB *t = share(value);
+	if (!t)
+		return tib_errno;
 
-	for (int i = 0; i < varlist.len; ++i)
+	if (vars[key])
 	{
-		if (key == varlist.vars[i].key)
-		{
-			TIB *old = varlist.vars[i].value;
-			varlist.vars[i].value = tib_copy(value);
-			if (tib_errno)
-			{
-				varlist.vars[i].value = old;
-				return tib_errno;
-			}
-
-			tib_decref(old);
-			return 0;
-		}
+		if (TIB_TYPE_LIST == vars[key]->type)
+			--num_list_vars;
+
+		tib_decref(vars[key]);
 	}
 
-	return TIB_EINDEX; // should be unreachable
+	if (TIB_TYPE_LIST == t->type)
+		++num_list_vars;
+
+	if (tib_var_is_constant(key))
+		++constants_version;
+
+	vars[key] = t;
+	return 0;
 }
 
 TIB *
 tib_var_get(int key)
 {
-	for (int i = 0; i < varlist.len; ++i)
-		if (key == varlist.vars[i].key)
-			return tib_copy(varlist.vars[i].value);
+	if (is_var_key(key) && vars[key])
+	{
+		tib_incref(vars[key]);
+		return vars[key];
+	}
 
 	return tib_new_complex(0, 0);
 }
 
+enum tib_type
+tib_var_type(int key)
+{
+	if (is_var_key(key) && vars[key])
+		return vars[key]->type;
+
+	return TIB_TYPE_COMPLEX;
+}
+
+bool
+tib_var_any_list()
+{
+	return num_list_vars || lists.len;
+}
+
 bool
 tib_is_var(int key)
 {
-	for (int i = 0; i < varlist.len; ++i)
-		if (key == varlist.vars[i].key)
-			return true;
+	return is_var_key(key) && vars[key] != NULL;
+}
+
+bool
+tib_var_is_constant(int key)
+{
+	return 'e' == key || TIB_CHAR_PI == key;
+}
+
+unsigned long
+tib_var_constants_version()
+{
+	return constants_version;
+}
+
+static int
+list_name_digit(int c, bool first)
+{
+	if (tib_isupper(c))
+		return c - 'A' + 1;
+
+	if (TIB_CHAR_THETA == c)
+		return 27;
+
+	if (!first && tib_isdigit(c))
+		return c - '0' + 28;
+
+	return 0;
+}
+
+/* packs a list name into a nonzero integer, or returns 0 if invalid */
+static int
+list_key(const struct tib_expr *name)
+{
+	int key = 0;
+
+	if (name->len < 1 || name->len > TIB_LIST_NAME_MAX)
+		return 0;
+
+	for (int i = 0; i < name->len; ++i)
+	{
+		int digit = list_name_digit(name->data[i], 0 == i);
+		if (!digit)
+			return 0;
+
+		key = key * LIST_NAME_BASE + digit;
+	}
+
+	return key;
+}
+
+static tib_Variable *
+list_slot(const struct list_table *table, int key)
+{
+	unsigned int mask = table->bufsize - 1;
+	unsigned int i = (unsigned int) key * 2654435761u;
+
+	i = (i ^ (i >> 16)) & mask;
+
+	while (table->slots[i].key && table->slots[i].key != key)
+		i = (i + 1) & mask;
+
+	return &table->slots[i];
+}
+
+static int
+grow_lists(void)
+{
+	struct list_table grown = {
+		.len = lists.len,
+		.bufsize = lists.bufsize ? lists.bufsize * 2 : LIST_TABLE_MIN
+	};
+
+	grown.slots = calloc(grown.bufsize, sizeof(tib_Variable));
+	if (!grown.slots)
+		return TIB_EALLOC;
+
+	for (int i = 0; i < lists.bufsize; ++i)
+		if (lists.slots[i].key)
+			*list_slot(&grown, lists.slots[i].key) = lists.slots[i];
+
+	free(lists.slots);
+	lists = grown;
+	return 0;
+}
+
+int
+tib_var_list_set(const struct tib_expr *name, TIB *value)
+{
+	int key = list_key(name);
+	if (!key)
+		return TIB_ESYNTAX;
+
+	if (TIB_TYPE_LIST != tib_type(value))
+		return TIB_ETYPE;
+
+	/* keep the load factor at or below 3/4 */
+	if (4 * (lists.len + 1) > 3 * lists.bufsize)
+	{
+		int rc = grow_lists();
+		if (rc)
+			return rc;
+	}
+
+	TIB *t = share(value);
+	if (!t)
+		return tib_errno;
+
+	tib_Variable *var = list_slot(&lists, key);
+	if (var->key)
+	{
+		tib_decref(var->value);
+	}
+	else
+	{
+		var->key = key;
+		++lists.len;
+	}
+
+	var->value = t;
+	return 0;
+}
+
+TIB *
+tib_var_list_get(const struct tib_expr *name)
+{
+	int key = list_key(name);
+	if (!key)
+	{
+		tib_errno = TIB_ESYNTAX;
+		return NULL;
+	}
+
+	if (lists.len)
+	{
+		tib_Variable *var = list_slot(&lists, key);
+		if (var->key)
+		{
+			tib_incref(var->value);
+			return var->value;
+		}
+	}
 
-	return false;
+	tib_errno = TIB_EINDEX;
+	return NULL;
 }
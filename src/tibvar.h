@@ -34,13 +34,42 @@ tib_var_init(void);
 void
 tib_var_free(void);
 
+/* the variable takes its own reference to value */
 int
-tib_var_set(int key, const TIB *value);
+tib_var_set(int key, TIB *value);
 
+/* returns a new reference to the shared value; do not modify it */
 TIB *
 tib_var_get(int key);
 
 bool
 tib_is_var(int key);
 
+/* the type tib_var_get would return, without taking a reference */
+enum tib_type
+tib_var_type(int key);
+
+/* false if no variable, user lists included, holds a list */
+bool
+tib_var_any_list(void);
+
+/* Constants may be folded into compiled code. Any change to one of
+ * them changes the version. */
+bool
+tib_var_is_constant(int key);
+
+unsigned long
+tib_var_constants_version(void);
+
+/* Named user lists (the ones written after TIB_CHAR_LUSER). The name is
+ * one to TIB_LIST_NAME_MAX letters, digits or theta and may not start
+ * with a digit. Only lists can be stored in them. */
+#define TIB_LIST_NAME_MAX 5
+
+int
+tib_var_list_set(const struct tib_expr *name, TIB *value);
+
+TIB *
+tib_var_list_get(const struct tib_expr *name);
+
 #endif
@@ -18,6 +18,7 @@
 #ifndef DELWINK_LIBERTI_UTIL_H
 #define DELWINK_LIBERTI_UTIL_H
 
+#include "tiberr.h"
 #include "tibexpr.h"
 
 int